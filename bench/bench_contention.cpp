@@ -0,0 +1,139 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QThread>
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+#include "benchmark.h"
+#include "database.h"
+#include "syntheticlibrary.h"
+
+// Times reads on the main thread of a generated library, first with no writer and then while
+// another thread syncs the library again as SyncWorker does: the new artists and albums of every
+// batch of tracks, then the tracks, each in its own transaction. Every thread has its own
+// connection in WAL mode, so the "syncing" latencies should stay close to the "idle" ones.
+
+// Writes library over and over in batches of batchSize tracks until stop is set. Every flush is
+// one sample of flushes.
+static bool syncLibrary(const QString &path, const SyntheticLibrary &library, int batchSize,
+                        const std::atomic_bool &stop, Benchmark &flushes)
+{
+    QHash<QString, const GMArtist *> artistsById;
+    for (const auto &artist : library.artists) {
+        artistsById.insert(artist.artistId, &artist);
+    }
+    QHash<QString, const GMAlbum *> albumsById;
+    for (const auto &album : library.albums) {
+        albumsById.insert(album.albumId, &album);
+    }
+
+    Database db;
+    if (!db.openConnection(path)) {
+        return false;
+    }
+    while (!stop) {
+        QSet<QString> artistsCache;
+        QSet<QString> albumsCache;
+        for (int first = 0; first < library.tracks.size() && !stop; first += batchSize) {
+            GMArtistList artists;
+            GMAlbumList albums;
+            GMTrackList tracks = library.tracks.mid(first, batchSize);
+            for (const auto &track : tracks) {
+                QString artistId = track.artistId.value(0);
+                if (!artistsCache.contains(artistId) && artistsById.contains(artistId)) {
+                    artists.append(*artistsById.value(artistId));
+                    artistsCache.insert(artistId);
+                }
+                if (!albumsCache.contains(track.albumId) && albumsById.contains(track.albumId)) {
+                    albums.append(*albumsById.value(track.albumId));
+                    albumsCache.insert(track.albumId);
+                }
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            if (db.insertArtists(artists) && db.insertAlbums(albums) && db.insertTracks(tracks)) {
+                flushes.addSample(timer.nsecsElapsed(), tracks.size());
+            } else {
+                flushes.addFailure();
+            }
+        }
+    }
+    return true;
+}
+
+static void timeReads(const QString &label, Database &db, const SyntheticLibrary &library,
+                      int reads, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    auto anyTrack  = [&] { return library.tracks[rng() % library.tracks.size()]; };
+    auto anyAlbum  = [&] { return library.albums[rng() % library.albums.size()]; };
+    auto anyArtist = [&] { return library.artists[rng() % library.artists.size()]; };
+
+    Benchmark::run("track, " + label, reads, [&](int) { return bool(db.track(anyTrack().id)); });
+    Benchmark::run("album, " + label, reads,
+                   [&](int) { return bool(db.album(anyAlbum().albumId)); });
+    Benchmark::run("artist, " + label, reads,
+                   [&](int) { return bool(db.artist(anyArtist().artistId)); });
+    Benchmark::run("tracksForAlbum, " + label, reads,
+                   [&](int) { return bool(db.tracksForAlbum(anyAlbum().albumId)); });
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_contention");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Read latency during a simulated sync on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.addOptions({
+        {"reads", "Reads timed per query and phase.", "n", "1000"},
+        {"batch-size", "Tracks per sync flush.", "n", QString::number(Database::DefaultBatchSize)},
+    });
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    int reads        = parser.value("reads").toInt();
+    int batchSize    = qMax(parser.value("batch-size").toInt(), 1);
+
+    QTemporaryDir tempDir;
+    QString path = tempDir.filePath(QStringLiteral("library.db"));
+    auto library = SyntheticLibrary::generate(spec);
+    if (library.tracks.isEmpty()) {
+        std::printf("the library is empty\n");
+        return 1;
+    }
+
+    // The library is stored before the reads start, so both phases read the same rows.
+    Database db;
+    if (!db.openConnection(path) || !db.createTables() || !library.store(db)) {
+        std::printf("could not create the library database\n");
+        return 1;
+    }
+    std::printf("library: %d artists, %d albums, %d tracks\n\n", library.artists.size(),
+                library.albums.size(), library.tracks.size());
+
+    Benchmark::printHeader();
+    timeReads("idle", db, library, reads, spec.seed);
+
+    std::atomic_bool stop(false);
+    bool synced = false;
+    Benchmark flushes("sync flush");
+    QScopedPointer<QThread> sync(QThread::create(
+        [&] { synced = syncLibrary(path, library, batchSize, stop, flushes); }));
+    sync->start();
+    timeReads("syncing", db, library, reads, spec.seed);
+    stop = true;
+    sync->wait();
+    flushes.report();
+
+    return synced ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <random>
+
+#include "benchmark.h"
+#include "database.h"
+#include "syntheticlibrary.h"
+
+// Times every public Database method against a generated library stored in a temporary SQLite
+// file. Runs headless and offline; the output is meant to be compared release to release. A
+// second table compares track loads of libraries of several sizes and track inserts with the
+// previous approaches.
+
+static int intOption(const QCommandLineParser &parser, const QString &name)
+{
+    return parser.value(name).toInt();
+}
+
+// Times a single call that processes items rows.
+template <class Fn> static bool timeBulk(const QString &name, int items, Fn &&fn)
+{
+    Benchmark bench(name);
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = fn();
+    if (ok) {
+        bench.addSample(timer.nsecsElapsed(), items);
+    } else {
+        bench.addFailure();
+    }
+    bench.report();
+    return ok;
+}
+
+static QList<int> intListOption(const QCommandLineParser &parser, const QString &name)
+{
+    QList<int> values;
+    for (const auto &value : parser.value(name).split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        values.append(value.toInt());
+    }
+    return values;
+}
+
+// A library of about count tracks, shaped like spec.
+static SyntheticLibrary generateTracks(const LibrarySpec &spec, int count)
+{
+    LibrarySpec sized = spec;
+    sized.artists     = qMax(1, count / qMax(1, spec.albumsPerArtist * spec.tracksPerAlbum));
+    return SyntheticLibrary::generate(sized);
+}
+
+static bool insertLibrary(Database &db, const QString &path, const SyntheticLibrary &library)
+{
+    return db.openConnection(path) && db.createTables() && library.store(db);
+}
+
+// Database::tracks() as it was before the artist links were read set-wise: one Track2Artist
+// query per track.
+static Opt<GMTrackList> tracksWithArtistPerTrack(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(QStringLiteral("SELECT id, albumId, name, genre, duration, trackNumber, year, "
+                                   "trackType, size from Track"))) {
+        return std::nullopt;
+    }
+
+    GMTrackList tracks;
+    while (query.next()) {
+        GMTrack track;
+        track.id             = query.value(0).toString();
+        track.albumId        = query.value(1).toString();
+        track.title          = query.value(2).toString();
+        track.genre          = query.value(3).toString();
+        track.durationMillis = query.value(4).toLongLong();
+        track.trackNumber    = query.value(5).toInt();
+        track.year           = query.value(6).toInt();
+        track.trackType      = query.value(7).toString();
+        track.estimatedSize  = query.value(8).toLongLong();
+
+        QSqlQuery artistQuery(db);
+        artistQuery.prepare(
+            QStringLiteral("SELECT artistId FROM Track2Artist WHERE trackId = :trackId"));
+        artistQuery.bindValue(":trackId", track.id);
+        if (!artistQuery.exec()) {
+            return std::nullopt;
+        }
+        while (artistQuery.next()) {
+            track.artistId.append(artistQuery.value(0).toString());
+        }
+        tracks.append(track);
+    }
+    return std::move(tracks);
+}
+
+// Loads libraries of every size in trackCounts with one artist query per track and with
+// Database::tracks(), which reads the artist links of all tracks in a second query.
+static void benchTrackLoads(const LibrarySpec &spec, const QList<int> &trackCounts,
+                            const QString &dir, int iterations)
+{
+    for (int count : trackCounts) {
+        auto library = generateTracks(spec, count);
+        QString path = QDir(dir).filePath(QStringLiteral("load-%1.db").arg(count));
+        Database db;
+        if (!insertLibrary(db, path, library)) {
+            qWarning() << "could not create" << path;
+            continue;
+        }
+
+        int tracks       = library.tracks.size();
+        QString suffix   = QStringLiteral(" (%1)").arg(tracks);
+        QString connName = QStringLiteral("per-track@%1").arg(path);
+        {
+            QSqlDatabase perTrackDb = QSqlDatabase::addDatabase("QSQLITE", connName);
+            perTrackDb.setDatabaseName(path);
+            if (perTrackDb.open()) {
+                Benchmark::run("tracks, artist per track" + suffix, iterations, [&](int) {
+                    auto loaded = tracksWithArtistPerTrack(perTrackDb);
+                    return loaded && loaded->size() == tracks;
+                });
+            }
+            perTrackDb.close();
+        }
+        QSqlDatabase::removeDatabase(connName);
+
+        Benchmark::run("tracks, artists set-wise" + suffix, iterations, [&](int) {
+            auto loaded = db.tracks();
+            return loaded && loaded->size() == tracks;
+        });
+    }
+}
+
+// Inserts a library of about count tracks into empty databases, once with a transaction per track
+// as the sync used to and once with Database::insertTracks() committing batchSize tracks at a time.
+static void benchTrackInserts(const LibrarySpec &spec, int count, int batchSize, const QString &dir)
+{
+    auto library = generateTracks(spec, count);
+    int tracks   = library.tracks.size();
+    for (bool batched : {false, true}) {
+        QString path = QDir(dir).filePath(batched ? "insert-batched.db" : "insert-per-track.db");
+        Database db;
+        if (!db.openConnection(path) || !db.createTables() || !db.insertArtists(library.artists) ||
+            !db.insertAlbums(library.albums)) {
+            qWarning() << "could not create" << path;
+            continue;
+        }
+        if (batched) {
+            timeBulk(QStringLiteral("insertTracks (batch %1)").arg(batchSize), tracks,
+                     [&] { return db.insertTracks(library.tracks, batchSize); });
+        } else {
+            timeBulk("insertTrack (per track)", tracks, [&] {
+                for (const auto &track : library.tracks) {
+                    if (!db.insertTrack(track)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_database");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Database micro-benchmarks on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.addOptions({
+        {"iterations", "Iterations of point lookups and writes.", "n", "1000"},
+        {"scan-iterations", "Iterations of whole-library loads.", "n", "10"},
+        {"database", "Keep the generated database at this path.", "path"},
+        {"load-tracks", "Library sizes of the track load comparison.", "n,...",
+         "1000,10000,100000"},
+        {"insert-tracks", "Tracks of the insert comparison.", "n", "5000"},
+        {"batch-size", "Tracks per transaction of batched inserts.", "n",
+         QString::number(Database::DefaultBatchSize)},
+    });
+    parser.process(app);
+
+    LibrarySpec spec   = LibrarySpec::fromParser(parser);
+    int iterations     = intOption(parser, "iterations");
+    int scanIterations = intOption(parser, "scan-iterations");
+
+    QTemporaryDir tempDir;
+    QString path = parser.isSet("database") ? parser.value("database")
+                                            : tempDir.filePath(QStringLiteral("library.db"));
+    QFile::remove(path);
+
+    QElapsedTimer generateTimer;
+    generateTimer.start();
+    auto library = SyntheticLibrary::generate(spec);
+    std::printf("library: %d artists, %d albums, %d tracks (generated in %lld ms)\n",
+                library.artists.size(), library.albums.size(), library.tracks.size(),
+                generateTimer.elapsed());
+    std::printf("database: %s\n\n", qPrintable(path));
+    if (library.tracks.isEmpty()) {
+        qWarning() << "the library is empty";
+        return 1;
+    }
+
+    Database db;
+    Benchmark::printHeader();
+
+    if (!timeBulk("openConnection", 1, [&] { return db.openConnection(path); }) ||
+        !timeBulk("createTables", 1, [&] { return db.createTables(); })) {
+        return 1;
+    }
+
+    timeBulk("insertArtists (library)", library.artists.size(),
+             [&] { return db.insertArtists(library.artists); });
+    timeBulk("insertAlbums (library)", library.albums.size(),
+             [&] { return db.insertAlbums(library.albums); });
+    timeBulk("insertTracks (library)", library.tracks.size(),
+             [&] { return db.insertTracks(library.tracks); });
+
+    std::mt19937 rng(spec.seed);
+    auto anyTrack  = [&] { return library.tracks[rng() % library.tracks.size()]; };
+    auto anyAlbum  = [&] { return library.albums[rng() % library.albums.size()]; };
+    auto anyArtist = [&] { return library.artists[rng() % library.artists.size()]; };
+
+    Benchmark::run("tracks", scanIterations, [&](int) { return bool(db.tracks()); });
+    Benchmark::run("trackViews", scanIterations, [&](int) { return bool(db.trackViews()); });
+    Benchmark::run("forEachTrack", scanIterations, [&](int) {
+        int visited = 0;
+        return db.forEachTrack([&visited](const GMTrack &) {
+            ++visited;
+            return true;
+        });
+    });
+    Benchmark::run("tracksPage", iterations, [&](int) {
+        return bool(db.tracksPage(anyTrack().id, Database::DefaultPageSize));
+    });
+    auto views = library.trackViews();
+    Benchmark::run("trackViewsPage", iterations, [&](int) {
+        const auto &view = views[rng() % views.size()];
+        TrackViewCursor after{view.artistName, view.albumName, view.track.trackNumber,
+                              view.track.id};
+        return bool(db.trackViewsPage(after, Database::DefaultPageSize));
+    });
+    Benchmark::run("tracksForAlbum", iterations,
+                   [&](int) { return bool(db.tracksForAlbum(anyAlbum().albumId)); });
+    Benchmark::run("trackViewsForAlbum", iterations,
+                   [&](int) { return bool(db.trackViewsForAlbum(anyAlbum().albumId)); });
+    Benchmark::run("tracksForArtist", iterations,
+                   [&](int) { return bool(db.tracksForArtist(anyArtist().artistId)); });
+    Benchmark::run("trackViewsForArtist", iterations,
+                   [&](int) { return bool(db.trackViewsForArtist(anyArtist().artistId)); });
+    Benchmark::run("track", iterations, [&](int) { return bool(db.track(anyTrack().id)); });
+    Benchmark::run("search", iterations, [&](int) {
+        return bool(db.search(anyTrack().title.left(3), 100));
+    });
+    Benchmark::run("artists", scanIterations, [&](int) { return bool(db.artists()); });
+    Benchmark::run("artist", iterations,
+                   [&](int) { return bool(db.artist(anyArtist().artistId)); });
+    Benchmark::run("albums", scanIterations, [&](int) { return bool(db.albums()); });
+    Benchmark::run("albumsForArtist", iterations,
+                   [&](int) { return bool(db.albumsForArtist(anyArtist().artistId)); });
+    Benchmark::run("album", iterations, [&](int) { return bool(db.album(anyAlbum().albumId)); });
+
+    // Writes replace existing rows so the library keeps its size.
+    Benchmark::run("insertTrack", iterations, [&](int) { return db.insertTrack(anyTrack()); });
+    Benchmark::run("insertArtist", iterations,
+                   [&](int) { return db.insertArtist(anyArtist()); });
+    Benchmark::run("insertAlbum", iterations, [&](int) { return db.insertAlbum(anyAlbum()); });
+    Benchmark::run("insertTracks (batch)", scanIterations, [&](int i) {
+        int from = (i * Database::DefaultBatchSize) % library.tracks.size();
+        return db.insertTracks(library.tracks.mid(from, Database::DefaultBatchSize));
+    });
+    Benchmark::run("removeTrack", iterations, [&](int i) {
+        const auto &track = library.tracks[i % library.tracks.size()];
+        return db.removeTrack(track.id);
+    });
+
+    std::printf("\n");
+    Benchmark::printHeader();
+    benchTrackLoads(spec, intListOption(parser, "load-tracks"), tempDir.path(), scanIterations);
+    benchTrackInserts(spec, intOption(parser, "insert-tracks"), intOption(parser, "batch-size"),
+                      tempDir.path());
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QHash>
+#include <QTemporaryDir>
+#include <QVariant>
+#include <cstdio>
+
+#include "database.h"
+#include "librarytree.h"
+#include "memoryestimate.h"
+#include "syntheticlibrary.h"
+
+// Estimates the heap used per node by a fully expanded library tree. "LibraryModelNode" is the
+// previous layout: one polymorphic heap object per node holding a QVariant copy of the whole
+// GMArtist or GMAlbum and a list of child pointers. "LibraryNode" is the flat node vector with its
+// child lists over a LibraryTree of interned display strings.
+
+// Same members as the previous node type.
+struct LegacyNode {
+    virtual ~LegacyNode() = default;
+
+    int level;
+    int index;
+    QVariant data;
+    bool is_leaf;
+    bool children_loaded;
+    QList<LegacyNode *> children;
+    LegacyNode *parent;
+};
+
+// A QVariant keeps values this large in a shared heap block: a pointer and a reference count
+// followed by the value.
+template <class T> static qint64 variantBytes()
+{
+    return sizeof(void *) + sizeof(int) + sizeof(T);
+}
+
+static qint64 legacyBytes(const GMArtistList &artists, const GMAlbumList &albums)
+{
+    QHash<QString, int> albumCount;
+    for (const auto &album : albums) {
+        for (const auto &artistId : album.artistId) {
+            ++albumCount[artistId];
+        }
+    }
+
+    MemoryEstimate estimate;
+    for (const auto &artist : artists) {
+        estimate.addBytes(sizeof(LegacyNode) + variantBytes<GMArtist>());
+        estimate.addBytes(4 * sizeof(int) + albumCount.value(artist.artistId) * sizeof(void *));
+        estimate.addString(artist.artistId);
+        estimate.addString(artist.name);
+        estimate.addString(artist.artistArtRef);
+        estimate.addString(artist.artistBio);
+    }
+    // Every album node held its own copy of the album, once under each of its artists.
+    for (const auto &album : albums) {
+        for (int i = 0; i < album.artistId.size(); ++i) {
+            estimate.addBytes(sizeof(LegacyNode) + variantBytes<GMAlbum>());
+            estimate.addString(detached(album.albumId));
+            estimate.addString(detached(album.name));
+            estimate.addString(detached(album.albumArtRef));
+            estimate.addString(detached(album.description));
+            estimate.addStringList(detached(album.artistId));
+        }
+    }
+    return estimate.bytes();
+}
+
+static qint64 flatBytes(const LibraryTree &tree, int nodes)
+{
+    MemoryEstimate estimate;
+    estimate.addBytes(qint64(nodes) * sizeof(LibraryNode));
+    estimate.addBytes(qint64(tree.artists.size() + tree.albums.size()) * sizeof(LibraryItem));
+    for (const auto &items : {tree.artists, tree.albums}) {
+        for (const auto &item : items) {
+            estimate.addString(item.id);
+            estimate.addString(item.name);
+            estimate.addString(item.artUrl);
+        }
+    }
+    estimate.addBytes(tree.artistAlbums.size() * sizeof(QVector<int>));
+    for (const auto &albums : tree.artistAlbums) {
+        estimate.addBytes(sizeof(QArrayData) + albums.capacity() * sizeof(int));
+    }
+    // The model's child lists: one per node, allocated for expanded artists, and the top level.
+    estimate.addBytes(qint64(nodes) * sizeof(QVector<int>));
+    estimate.addBytes(sizeof(QArrayData) + tree.artists.size() * sizeof(int));
+    for (const auto &albums : tree.artistAlbums) {
+        estimate.addBytes(albums.isEmpty() ? 0 : sizeof(QArrayData) + albums.size() * sizeof(int));
+    }
+    return estimate.bytes();
+}
+
+static void report(const char *name, qint64 bytes, int nodes)
+{
+    std::printf("%-28s %10.1f %12.1f\n", name, double(bytes) / nodes,
+                double(bytes) / (1024 * 1024));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_librarymemory");
+
+    // Libraries without tracks; only the artists and albums are read.
+    LibrarySpec defaults;
+    defaults.artists         = 5000;
+    defaults.albumsPerArtist = 8;
+    defaults.tracksPerAlbum  = 0;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Library tree memory report on a synthetic library");
+    parser.addHelpOption();
+    defaults.addOptions(parser);
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+
+    QTemporaryDir tempDir;
+    auto library = SyntheticLibrary::generate(spec);
+    Database db;
+    if (!db.openConnection(tempDir.filePath(QStringLiteral("library.db"))) ||
+        !db.createTables() || !db.insertArtists(library.artists) ||
+        !db.insertAlbums(library.albums)) {
+        std::printf("could not create the library database\n");
+        return 1;
+    }
+
+    auto artists = db.artists();
+    auto albums  = db.albums();
+    auto tree    = LibraryTree::load(db);
+    if (!artists || !albums || !tree) {
+        std::printf("could not read the library\n");
+        return 1;
+    }
+
+    int nodes = tree->artists.size();
+    for (const auto &artistAlbums : tree->artistAlbums) {
+        nodes += artistAlbums.size();
+    }
+    if (nodes == 0) {
+        std::printf("the library is empty\n");
+        return 1;
+    }
+
+    std::printf("nodes: %d, sizeof(LibraryModelNode): %zu, sizeof(LibraryNode): %zu\n\n", nodes,
+                sizeof(LegacyNode), sizeof(LibraryNode));
+    std::printf("%-28s %10s %12s\n", "storage", "bytes/node", "total MiB");
+    report("LibraryModelNode", legacyBytes(*artists, *albums), nodes);
+    report("LibraryNode + LibraryTree", flatBytes(*tree, nodes), nodes);
+
+    return 0;
+}
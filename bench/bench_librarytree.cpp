@@ -0,0 +1,73 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <cstdio>
+
+#include "benchmark.h"
+#include "database.h"
+#include "librarytree.h"
+#include "syntheticlibrary.h"
+
+// Reads the artist/album tree of a generated library. "build_tree" is the previous approach of
+// reading the artists and then the albums of every artist; "LibraryTree::load" reads everything
+// in three queries and joins the rows in memory.
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_librarytree");
+
+    // Libraries without tracks; only the artists and albums are read.
+    LibrarySpec defaults;
+    defaults.artists         = 5000;
+    defaults.albumsPerArtist = 8;
+    defaults.tracksPerAlbum  = 0;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Library tree load benchmark on a synthetic library");
+    parser.addHelpOption();
+    defaults.addOptions(parser);
+    parser.addOptions({
+        {"iterations", "Tree loads per method.", "n", "10"},
+    });
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    int iterations   = parser.value("iterations").toInt();
+
+    QTemporaryDir tempDir;
+    QString path = tempDir.filePath(QStringLiteral("library.db"));
+    auto library = SyntheticLibrary::generate(spec);
+
+    Database db;
+    if (!db.openConnection(path) || !db.createTables() || !db.insertArtists(library.artists) ||
+        !db.insertAlbums(library.albums)) {
+        std::printf("could not create the library database\n");
+        return 1;
+    }
+    std::printf("library: %d artists, %d albums\n\n", library.artists.size(),
+                library.albums.size());
+
+    Benchmark::printHeader();
+    Benchmark::run("build_tree", iterations, [&](int) {
+        auto artists = db.artists();
+        if (!artists) {
+            return false;
+        }
+        int albums = 0;
+        for (const auto &artist : *artists) {
+            auto artistAlbums = db.albumsForArtist(artist.artistId);
+            if (!artistAlbums) {
+                return false;
+            }
+            albums += artistAlbums->size();
+        }
+        return albums == library.albums.size();
+    });
+    Benchmark::run("LibraryTree::load", iterations, [&](int) {
+        auto tree = LibraryTree::load(db);
+        return tree && tree->albums.size() == library.albums.size();
+    });
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <cstdio>
+#include <random>
+
+#include "benchmark.h"
+#include "syntheticlibrary.h"
+#include "trackrows.h"
+
+// Types filter texts one character at a time against the rows of a generated library, as the
+// track table filter does. "full" matches every row for each keystroke, "refine" only the rows
+// that matched the previous text. Both run on one thread; the table spreads the work over the
+// global thread pool.
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_trackfilter");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Track table filter benchmark on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.addOptions({
+        {"queries", "Filter texts typed per method.", "n", "20"},
+    });
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    int queries      = parser.value("queries").toInt();
+
+    StringPool pool;
+    TrackRowList rows = SyntheticLibrary::generate(spec).trackRows(pool);
+    if (rows.isEmpty()) {
+        std::printf("the library is empty\n");
+        return 1;
+    }
+    std::printf("rows: %d\n\n", rows.size());
+
+    // Each text is the title of a random track followed by its artist.
+    std::mt19937 rng(spec.seed);
+    QStringList texts;
+    for (int i = 0; i < queries; ++i) {
+        const auto &row = rows[rng() % rows.size()];
+        texts.append(row.title + QLatin1Char(' ') + row.artist);
+    }
+
+    Benchmark::printHeader();
+    Benchmark full("full");
+    Benchmark refine("refine");
+    for (const auto &text : texts) {
+        QVector<int> previous;
+        for (int length = 1; length <= text.size(); ++length) {
+            QStringList words = TrackRows::searchWords(text.left(length));
+
+            QElapsedTimer timer;
+            timer.start();
+            QVector<int> matched;
+            for (int row = 0; row < rows.size(); ++row) {
+                if (TrackRows::matches(rows[row], words)) {
+                    matched.append(row);
+                }
+            }
+            full.addSample(timer.nsecsElapsed(), rows.size());
+
+            timer.restart();
+            QVector<int> refined;
+            if (length == 1) {
+                refined = matched;
+            } else {
+                for (int row : previous) {
+                    if (TrackRows::matches(rows[row], words)) {
+                        refined.append(row);
+                    }
+                }
+            }
+            refine.addSample(timer.nsecsElapsed(), qMax(previous.size(), 1));
+
+            if (refined != matched) {
+                refine.addFailure();
+            }
+            previous = matched;
+        }
+    }
+    full.report();
+    refine.report();
+
+    return 0;
+}
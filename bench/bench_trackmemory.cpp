@@ -0,0 +1,126 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <cstdio>
+
+#include "memoryestimate.h"
+#include "syntheticlibrary.h"
+#include "trackrows.h"
+
+// Estimates the heap used per track by the rows the track table keeps in memory. "GMTrack" is
+// the previous model storage, "TrackRow" the current rows without and with a StringPool. Every
+// string is deep-copied first, as the SQL driver returns a new buffer for every value it reads.
+// Allocator overhead is ignored, so the numbers are lower bounds.
+
+static GMTrackView detached(const GMTrackView &view)
+{
+    GMTrackView copy     = view;
+    copy.track.title     = detached(view.track.title);
+    copy.track.albumId   = detached(view.track.albumId);
+    copy.track.artistId  = detached(view.track.artistId);
+    copy.track.id        = detached(view.track.id);
+    copy.track.genre     = detached(view.track.genre);
+    copy.track.trackType = detached(view.track.trackType);
+    copy.albumName       = detached(view.albumName);
+    copy.albumArtRef     = detached(view.albumArtRef);
+    copy.artistName      = detached(view.artistName);
+    copy.artistArtRef    = detached(view.artistArtRef);
+    return copy;
+}
+
+static qint64 trackBytes(const GMTrackList &tracks)
+{
+    MemoryEstimate estimate;
+    estimate.addBytes(qint64(tracks.size()) * sizeof(GMTrack));
+    for (const auto &track : tracks) {
+        estimate.addString(track.title);
+        estimate.addString(track.albumId);
+        estimate.addStringList(track.artistId);
+        estimate.addString(track.id);
+        estimate.addString(track.genre);
+        estimate.addString(track.trackType);
+    }
+    return estimate.bytes();
+}
+
+static qint64 rowBytes(const TrackRowList &rows)
+{
+    MemoryEstimate estimate;
+    estimate.addBytes(qint64(rows.size()) * sizeof(TrackRow));
+    for (const auto &row : rows) {
+        estimate.addString(row.id);
+        estimate.addString(row.title);
+        estimate.addString(row.album);
+        estimate.addString(row.artist);
+        estimate.addString(row.duration);
+        estimate.addString(row.searchTitle);
+        estimate.addString(row.searchAlbum);
+        estimate.addString(row.searchArtist);
+    }
+    return estimate.bytes();
+}
+
+// The pool keeps one hash node (next pointer, hash and string) per string plus a bucket array of
+// about the same length; the strings themselves are shared with the rows.
+static qint64 poolBytes(const StringPool &pool)
+{
+    return qint64(pool.size()) * (3 * sizeof(void *) + sizeof(void *));
+}
+
+static void report(const char *name, qint64 bytes, int tracks)
+{
+    std::printf("%-28s %10.1f %12.1f\n", name, double(bytes) / tracks,
+                double(bytes) / (1024 * 1024));
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_trackmemory");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Track table memory report on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+
+    GMTrackViewList views;
+    for (const auto &view : SyntheticLibrary::generate(spec).trackViews()) {
+        views.append(detached(view));
+    }
+    if (views.isEmpty()) {
+        std::printf("the library is empty\n");
+        return 1;
+    }
+
+    GMTrackList tracks;
+    tracks.reserve(views.size());
+    for (const auto &view : views) {
+        tracks.append(view.track);
+    }
+
+    // Without a pool every row owns its strings, as each view does.
+    TrackRowList plainRows;
+    plainRows.reserve(views.size());
+    for (const auto &view : views) {
+        StringPool unshared;
+        plainRows.append(TrackRows::fromView(view, unshared));
+    }
+
+    StringPool pool;
+    TrackRowList pooledRows;
+    pooledRows.reserve(views.size());
+    for (const auto &view : views) {
+        pooledRows.append(TrackRows::fromView(view, pool));
+    }
+
+    std::printf("tracks: %d, sizeof(GMTrack): %zu, sizeof(TrackRow): %zu, pooled strings: %d\n\n",
+                views.size(), sizeof(GMTrack), sizeof(TrackRow), pool.size());
+    std::printf("%-28s %10s %12s\n", "storage", "bytes/track", "total MiB");
+    report("GMTrack", trackBytes(tracks), views.size());
+    report("TrackRow", rowBytes(plainRows), views.size());
+    report("TrackRow + StringPool", rowBytes(pooledRows) + poolBytes(pool), views.size());
+
+    return 0;
+}
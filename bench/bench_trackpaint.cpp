@@ -0,0 +1,119 @@
+#include <QAbstractTableModel>
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <cstdio>
+
+#include "benchmark.h"
+#include "librarytableview.h"
+#include "syntheticlibrary.h"
+#include "trackrowdelegate.h"
+#include "trackrows.h"
+
+// Times the frames of a track table scrolled from top to bottom. "QStyledItemDelegate" paints
+// through the model roles as the table used to, "TrackRowDelegate" paints from the rows with a
+// uniform row height. Run with -platform offscreen to benchmark without a display.
+
+#define ROW_HEIGHT 30
+
+// Serves rows through data() the way TrackListModel does.
+class RowModel : public QAbstractTableModel
+{
+public:
+    explicit RowModel(const TrackRowList &rows) : rows_(rows)
+    {
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : rows_.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : 5;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid()) {
+            return QVariant();
+        }
+        if (role == Qt::DisplayRole) {
+            if (index.column() == 0) {
+                return rows_[index.row()].number;
+            }
+            return TrackRowDelegate::columnText(rows_[index.row()], index.column());
+        } else if (role == Qt::SizeHintRole) {
+            return QSize(INT_MAX, ROW_HEIGHT);
+        }
+        return QVariant();
+    }
+
+    const TrackRow *rowAt(const QModelIndex &index) const
+    {
+        return index.isValid() ? &rows_[index.row()] : nullptr;
+    }
+
+private:
+    TrackRowList rows_;
+};
+
+static void scrollFrames(const QString &name, LibraryTableView &view, int frames)
+{
+    QScrollBar *bar = view.verticalScrollBar();
+    bar->setValue(0);
+    QApplication::processEvents();
+
+    Benchmark::run(name, frames, [&](int i) {
+        bar->setValue(qint64(bar->maximum()) * i / qMax(frames - 1, 1));
+        view.viewport()->repaint();
+        return true;
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    app.setApplicationName("bench_trackpaint");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Track table paint benchmark on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.addOptions({
+        {"frames", "Frames painted per delegate.", "n", "1000"},
+        {"width", "Width of the table.", "pixels", "1280"},
+        {"height", "Height of the table.", "pixels", "800"},
+    });
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    int frames       = parser.value("frames").toInt();
+
+    StringPool pool;
+    TrackRowList rows = SyntheticLibrary::generate(spec).trackRows(pool);
+    TrackRows::sort(rows);
+    RowModel model(rows);
+    std::printf("rows: %d\n\n", rows.size());
+
+    LibraryTableView view;
+    view.resize(parser.value("width").toInt(), parser.value("height").toInt());
+    view.setModel(&model);
+    view.setSelectionBehavior(QAbstractItemView::SelectRows);
+    view.setShowGrid(false);
+    view.horizontalHeader()->setStretchLastSection(true);
+    view.verticalHeader()->setDefaultSectionSize(ROW_HEIGHT);
+    view.show();
+
+    Benchmark::printHeader();
+    scrollFrames("QStyledItemDelegate", view, frames);
+
+    TrackRowDelegate delegate([&model](const QModelIndex &index) { return model.rowAt(index); });
+    view.setItemDelegate(&delegate);
+    view.setUniformRowHeight(ROW_HEIGHT);
+    scrollFrames("TrackRowDelegate", view, frames);
+
+    return 0;
+}
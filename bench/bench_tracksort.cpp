@@ -0,0 +1,117 @@
+#include <QAbstractTableModel>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSortFilterProxyModel>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+#include "benchmark.h"
+#include "syntheticlibrary.h"
+#include "trackrows.h"
+
+// Sorts the shuffled rows of a generated library in track table order. "proxy lessThan" is the
+// previous approach of a QSortFilterProxyModel comparing the artist, album and number roles with
+// QString's operator<; "TrackRows::sort" collates every distinct name once and sorts on integer
+// keys.
+
+// The roles TrackListModel serves the sort fields under.
+enum Roles { Number = Qt::UserRole + 1, Title, Album, Artist };
+
+class RowModel : public QAbstractTableModel
+{
+public:
+    explicit RowModel(const TrackRowList &rows) : rows_(rows)
+    {
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : rows_.size();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : 5;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid()) {
+            return QVariant();
+        }
+        const auto &row = rows_[index.row()];
+        if (role == Roles::Number) {
+            return row.number;
+        } else if (role == Roles::Album) {
+            return row.album;
+        } else if (role == Roles::Artist) {
+            return row.artist;
+        }
+        return QVariant();
+    }
+
+private:
+    TrackRowList rows_;
+};
+
+// The track table proxy before the rows were sorted in the source model.
+class RoleSortingModel : public QSortFilterProxyModel
+{
+protected:
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override
+    {
+        auto artistLeft  = left.data(Roles::Artist).toString();
+        auto artistRight = right.data(Roles::Artist).toString();
+        if (artistLeft != artistRight) {
+            return artistLeft < artistRight;
+        }
+        auto albumLeft  = left.data(Roles::Album).toString();
+        auto albumRight = right.data(Roles::Album).toString();
+        if (albumLeft != albumRight) {
+            return albumLeft < albumRight;
+        }
+        return left.data(Roles::Number).toInt() < right.data(Roles::Number).toInt();
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("bench_tracksort");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Track table sort benchmark on a synthetic library");
+    parser.addHelpOption();
+    LibrarySpec().addOptions(parser);
+    parser.addOptions({
+        {"iterations", "Sorts per method.", "n", "10"},
+    });
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    int iterations   = parser.value("iterations").toInt();
+
+    StringPool pool;
+    TrackRowList shuffled = SyntheticLibrary::generate(spec).trackRows(pool);
+    // The library is generated album by album, with every album's tracks together and in order.
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(spec.seed));
+    std::printf("rows: %d\n\n", shuffled.size());
+
+    Benchmark::printHeader();
+    Benchmark::run("proxy lessThan", iterations, [&](int) {
+        RowModel model(shuffled);
+        RoleSortingModel proxy;
+        proxy.setSourceModel(&model);
+        proxy.sort(0);
+        return proxy.rowCount() == shuffled.size();
+    });
+    Benchmark::run("TrackRows::sort", iterations, [&](int) {
+        auto rows = shuffled;
+        TrackRows::sort(rows);
+        return std::is_sorted(rows.begin(), rows.end(), TrackRows::lessThan);
+    });
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+
+Benchmark::Benchmark(const QString &name) : name_(name), totalNsecs_(0), items_(0), failures_(0)
+{
+}
+
+// A sample covering several items, e.g. a batch insert, counts every item towards throughput.
+void Benchmark::addSample(qint64 nsecs, int items)
+{
+    samples_.append(nsecs);
+    totalNsecs_ += nsecs;
+    items_ += items;
+}
+
+void Benchmark::addFailure()
+{
+    ++failures_;
+}
+
+void Benchmark::printHeader()
+{
+    std::printf("%-32s %8s %14s %12s %12s %8s\n", "operation", "ops", "items/s", "p50 (us)",
+                "p99 (us)", "failed");
+}
+
+void Benchmark::report() const
+{
+    if (samples_.isEmpty()) {
+        std::printf("%-32s %8d %14s %12s %12s %8d\n", qPrintable(name_), 0, "-", "-", "-",
+                    failures_);
+        return;
+    }
+
+    auto sorted = samples_;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        int index = std::min<int>(sorted.size() - 1, static_cast<int>(p * sorted.size()));
+        return sorted[index] / 1000.0;
+    };
+    double throughput = totalNsecs_ > 0 ? items_ * 1e9 / totalNsecs_ : 0.0;
+
+    std::printf("%-32s %8d %14.1f %12.1f %12.1f %8d\n", qPrintable(name_), samples_.size(),
+                throughput, percentile(0.50), percentile(0.99), failures_);
+    std::fflush(stdout);
+}
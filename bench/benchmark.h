@@ -0,0 +1,48 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+// Collects per-operation latencies and prints one report line: operation count, throughput and
+// p50/p99 latency.
+class Benchmark
+{
+public:
+    explicit Benchmark(const QString &name);
+
+    // Times fn once per iteration. fn receives the iteration number and returns false on failure;
+    // failed operations are counted but not timed.
+    template <class Fn> static void run(const QString &name, int iterations, Fn &&fn)
+    {
+        Benchmark bench(name);
+        for (int i = 0; i < iterations; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            bool ok = fn(i);
+            qint64 elapsed = timer.nsecsElapsed();
+            if (ok) {
+                bench.addSample(elapsed);
+            } else {
+                bench.addFailure();
+            }
+        }
+        bench.report();
+    }
+
+    void addSample(qint64 nsecs, int items = 1);
+    void addFailure();
+    void report() const;
+
+    static void printHeader();
+
+private:
+    QString name_;
+    QVector<qint64> samples_;
+    qint64 totalNsecs_;
+    qint64 items_;
+    int failures_;
+};
+
+#endif // BENCHMARK_H
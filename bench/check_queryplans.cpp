@@ -0,0 +1,115 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QRegularExpression>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QThread>
+#include <cstdio>
+
+#include "database.h"
+#include "syntheticlibrary.h"
+
+// Runs the library queries on a generated library and checks the query plans of every statement
+// they prepared: a plan that reads a whole table, SCAN without USING INDEX or a constraint passed
+// to a virtual table, fails the check. Exits with 1 on failure; CTest runs it as the
+// check_queryplans test.
+//
+// tracks(), trackViews(), artists() and albums() load whole tables by design and are not checked.
+
+// The queries checked. They run on a thread of their own, whose fresh connection has prepared no
+// other statement. The inserts rewrite rows that exist already; the track is removed last.
+static bool runQueries(Database &db, const SyntheticLibrary &library)
+{
+    const auto &track  = library.tracks.at(library.tracks.size() / 2);
+    const auto &album  = library.albums.at(library.albums.size() / 2);
+    const auto &artist = library.artists.at(library.artists.size() / 2);
+    auto views         = db.trackViewsPage(std::nullopt, Database::DefaultPageSize);
+    if (!views || views->isEmpty()) {
+        return false;
+    }
+    const auto &last = views->last();
+    TrackViewCursor after{last.artistName, last.albumName, last.track.trackNumber, last.track.id};
+
+    return db.track(track.id) && db.tracksPage(track.id, Database::DefaultPageSize) &&
+           db.trackViewsPage(after, Database::DefaultPageSize) &&
+           db.tracksForAlbum(album.albumId) && db.trackViewsForAlbum(album.albumId) &&
+           db.tracksForArtist(artist.artistId) && db.trackViewsForArtist(artist.artistId) &&
+           db.artist(artist.artistId) &&
+           db.album(album.albumId) && db.albumsForArtist(artist.artistId) &&
+           db.search(track.title, 10) &&
+           db.insertArtist(artist) && db.insertAlbum(album) && db.insertTrack(track) &&
+           db.removeTrack(track.id);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("check_queryplans");
+
+    LibrarySpec defaults;
+    defaults.artists = 200;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks that the library queries use indexes");
+    parser.addHelpOption();
+    defaults.addOptions(parser);
+    parser.process(app);
+
+    LibrarySpec spec = LibrarySpec::fromParser(parser);
+    auto library     = SyntheticLibrary::generate(spec);
+    if (library.tracks.isEmpty()) {
+        std::printf("the library is empty\n");
+        return 1;
+    }
+
+    QTemporaryDir tempDir;
+    QString path = tempDir.filePath(QStringLiteral("library.db"));
+    Database db;
+    if (!db.openConnection(path) || !db.createTables() || !library.store(db)) {
+        std::printf("could not create the library database\n");
+        return 1;
+    }
+
+    Opt<QHash<QString, QStringList>> plans;
+    QScopedPointer<QThread> explain(QThread::create([&path, &library, &plans] {
+        Database queries;
+        if (queries.openConnection(path) && runQueries(queries, library)) {
+            plans = queries.queryPlans();
+        }
+    }));
+    explain->start();
+    explain->wait();
+    if (!plans || plans->isEmpty()) {
+        std::printf("could not run the queries\n");
+        return 1;
+    }
+
+    // Subqueries and constant rows are scanned too; only scans of a table or its alias count.
+    QRegularExpression scan(QStringLiteral("^SCAN (?!CONSTANT ROW|SUBQUERY|\\()(\\w+)"));
+    QRegularExpression materialized(QStringLiteral("^(MATERIALIZE|CO-ROUTINE) (\\w+)"));
+    // A virtual table scan with an empty index string, "INDEX 0:", reads the whole table.
+    QRegularExpression usingIndex(
+        QStringLiteral("USING (COVERING )?INDEX|VIRTUAL TABLE INDEX \\d+:."));
+    int failures = 0;
+    for (auto it = plans->constBegin(); it != plans->constEnd(); ++it) {
+        // A subquery in FROM, e.g. the single row TrackView is filled from, is named like a table.
+        QSet<QString> subqueries;
+        for (const auto &detail : it.value()) {
+            auto match = materialized.match(detail);
+            if (match.hasMatch()) {
+                subqueries.insert(match.captured(2));
+            }
+        }
+        for (const auto &detail : it.value()) {
+            auto match = scan.match(detail);
+            if (match.hasMatch() && !subqueries.contains(match.captured(1)) &&
+                !usingIndex.match(detail).hasMatch()) {
+                std::printf("FAIL %s\n     %s\n", qPrintable(detail), qPrintable(it.key()));
+                ++failures;
+            }
+        }
+    }
+    std::printf("%d statements checked, %d full table scans\n", plans->size(), failures);
+    return failures == 0 ? 0 : 1;
+}
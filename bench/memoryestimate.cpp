@@ -0,0 +1,43 @@
+#include "memoryestimate.h"
+
+void MemoryEstimate::addBytes(qint64 bytes)
+{
+    bytes_ += bytes;
+}
+
+void MemoryEstimate::addString(const QString &string)
+{
+    if (string.capacity() == 0 || buffers_.contains(string.constData())) {
+        return;
+    }
+    buffers_.insert(string.constData());
+    bytes_ += sizeof(QArrayData) + (string.capacity() + 1) * sizeof(QChar);
+}
+
+void MemoryEstimate::addStringList(const QStringList &list)
+{
+    // QListData header followed by one pointer sized slot per item.
+    bytes_ += 4 * sizeof(int) + list.size() * sizeof(void *);
+    for (const auto &string : list) {
+        addString(string);
+    }
+}
+
+qint64 MemoryEstimate::bytes() const
+{
+    return bytes_;
+}
+
+QString detached(const QString &string)
+{
+    return string.isEmpty() ? QString() : QString(string.constData(), string.size());
+}
+
+QStringList detached(const QStringList &list)
+{
+    QStringList copy;
+    for (const auto &string : list) {
+        copy.append(detached(string));
+    }
+    return copy;
+}
@@ -0,0 +1,27 @@
+#ifndef MEMORYESTIMATE_H
+#define MEMORYESTIMATE_H
+
+#include <QSet>
+#include <QStringList>
+
+// Adds up container sizes, counting a string buffer shared by several strings once. Allocator
+// overhead is ignored, so the totals are lower bounds.
+class MemoryEstimate
+{
+public:
+    void addBytes(qint64 bytes);
+    void addString(const QString &string);
+    void addStringList(const QStringList &list);
+
+    qint64 bytes() const;
+
+private:
+    QSet<const void *> buffers_;
+    qint64 bytes_ = 0;
+};
+
+// Returns a copy of string with a buffer of its own, as the SQL driver returns every value.
+QString detached(const QString &string);
+QStringList detached(const QStringList &list);
+
+#endif // MEMORYESTIMATE_H
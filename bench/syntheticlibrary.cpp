@@ -0,0 +1,175 @@
+#include "syntheticlibrary.h"
+
+#include <QCommandLineParser>
+#include <QHash>
+#include <random>
+
+#include "database.h"
+
+static const char *const SYLLABLES[] = {"ka", "lo", "mi", "ren", "sa", "to", "vel", "dor", "an",
+                                        "bri", "cu", "el", "fa", "gon", "ix", "ju", "mor", "ne",
+                                        "ol", "pra", "qui", "ry", "sun", "tha", "u", "wen", "zo"};
+
+static const char *const GENRES[] = {"Rock",  "Pop",     "Jazz",       "Classical",
+                                     "Metal", "Hip-Hop", "Electronic", "Folk",
+                                     "Blues", "Reggae",  "Soundtrack", "Ambient"};
+
+template <class T, size_t N> static const T &pick(std::mt19937 &rng, const T (&items)[N])
+{
+    return items[std::uniform_int_distribution<size_t>(0, N - 1)(rng)];
+}
+
+static QString makeWord(std::mt19937 &rng)
+{
+    int syllables = std::uniform_int_distribution<int>(1, 3)(rng);
+    QString word;
+    for (int i = 0; i < syllables; ++i) {
+        word += QLatin1String(pick(rng, SYLLABLES));
+    }
+    word[0] = word[0].toUpper();
+    return word;
+}
+
+static QString makeName(std::mt19937 &rng, int minWords, int maxWords)
+{
+    int words = std::uniform_int_distribution<int>(minWords, maxWords)(rng);
+    QStringList name;
+    for (int i = 0; i < words; ++i) {
+        name.append(makeWord(rng));
+    }
+    return name.join(QLatin1Char(' '));
+}
+
+static QString makeId(const char *prefix, int n)
+{
+    return QStringLiteral("%1-%2").arg(QLatin1String(prefix)).arg(n, 7, 10, QLatin1Char('0'));
+}
+
+void LibrarySpec::addOptions(QCommandLineParser &parser) const
+{
+    parser.addOptions({
+        {"artists", "Number of artists.", "n", QString::number(artists)},
+        {"albums-per-artist", "Albums per artist.", "n", QString::number(albumsPerArtist)},
+        {"tracks-per-album", "Tracks per album.", "n", QString::number(tracksPerAlbum)},
+        {"featured", "Percentage of tracks with featured artists.", "percent",
+         QString::number(qRound(featuredRatio * 100))},
+        {"seed", "Seed of the library generator.", "n", QString::number(seed)},
+    });
+}
+
+LibrarySpec LibrarySpec::fromParser(const QCommandLineParser &parser)
+{
+    LibrarySpec spec;
+    spec.artists         = parser.value("artists").toInt();
+    spec.albumsPerArtist = parser.value("albums-per-artist").toInt();
+    spec.tracksPerAlbum  = parser.value("tracks-per-album").toInt();
+    spec.featuredRatio   = parser.value("featured").toInt() / 100.0;
+    spec.seed            = parser.value("seed").toUInt();
+    return spec;
+}
+
+SyntheticLibrary SyntheticLibrary::generate(const LibrarySpec &spec)
+{
+    std::mt19937 rng(spec.seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int> anyArtist(0, std::max(spec.artists - 1, 0));
+
+    SyntheticLibrary library;
+    library.artists.reserve(spec.artists);
+    library.albums.reserve(spec.artists * spec.albumsPerArtist);
+    library.tracks.reserve(spec.artists * spec.albumsPerArtist * spec.tracksPerAlbum);
+
+    for (int a = 0; a < spec.artists; ++a) {
+        GMArtist artist;
+        artist.artistId     = makeId("artist", a);
+        artist.name         = makeName(rng, 1, 3);
+        artist.artistArtRef = QStringLiteral("https://example.com/artist/%1.jpg").arg(a);
+        artist.artistBio    = makeName(rng, 10, 30);
+        library.artists.append(artist);
+    }
+
+    for (int a = 0; a < spec.artists; ++a) {
+        for (int b = 0; b < spec.albumsPerArtist; ++b) {
+            GMAlbum album;
+            album.albumId     = makeId("album", library.albums.size());
+            album.name        = makeName(rng, 1, 4);
+            album.albumArtRef = QStringLiteral("https://example.com/album/%1.jpg")
+                                    .arg(library.albums.size());
+            album.year        = std::uniform_int_distribution<int>(1960, 2020)(rng);
+            album.description = makeName(rng, 5, 15);
+            album.artistId    = QStringList{library.artists[a].artistId};
+            library.albums.append(album);
+
+            for (int t = 0; t < spec.tracksPerAlbum; ++t) {
+                GMTrack track;
+                track.id             = makeId("track", library.tracks.size());
+                track.albumId        = album.albumId;
+                track.artistId       = QStringList{library.artists[a].artistId};
+                track.title          = makeName(rng, 1, 5);
+                track.genre          = QLatin1String(pick(rng, GENRES));
+                track.trackType      = QStringLiteral("8");
+                track.durationMillis = std::uniform_int_distribution<int>(90, 600)(rng) * 1000;
+                track.trackNumber    = t + 1;
+                track.year           = album.year;
+                track.estimatedSize  = track.durationMillis * 40;
+                if (chance(rng) < spec.featuredRatio) {
+                    int featured = std::uniform_int_distribution<int>(1, 2)(rng);
+                    for (int f = 0; f < featured; ++f) {
+                        QString artistId = library.artists[anyArtist(rng)].artistId;
+                        if (!track.artistId.contains(artistId)) {
+                            track.artistId.append(artistId);
+                        }
+                    }
+                }
+                library.tracks.append(track);
+            }
+        }
+    }
+
+    return library;
+}
+
+bool SyntheticLibrary::store(Database &db) const
+{
+    return db.insertArtists(artists) && db.insertAlbums(albums) && db.insertTracks(tracks);
+}
+
+GMTrackViewList SyntheticLibrary::trackViews() const
+{
+    QHash<QString, const GMArtist *> artistsById;
+    for (const auto &artist : artists) {
+        artistsById.insert(artist.artistId, &artist);
+    }
+    QHash<QString, const GMAlbum *> albumsById;
+    for (const auto &album : albums) {
+        albumsById.insert(album.albumId, &album);
+    }
+
+    GMTrackViewList views;
+    views.reserve(tracks.size());
+    for (const auto &track : tracks) {
+        const GMArtist *artist = artistsById.value(track.artistId.value(0));
+        const GMAlbum *album   = albumsById.value(track.albumId);
+
+        GMTrackView view;
+        view.track          = track;
+        view.track.artistId = QStringList{track.artistId.value(0)};
+        view.albumName      = album ? album->name : QString();
+        view.albumYear      = album ? album->year : 0;
+        view.albumArtRef    = album ? album->albumArtRef : QString();
+        view.artistName     = artist ? artist->name : QString();
+        view.artistArtRef   = artist ? artist->artistArtRef : QString();
+        views.append(view);
+    }
+    return views;
+}
+
+TrackRowList SyntheticLibrary::trackRows(StringPool &pool) const
+{
+    TrackRowList rows;
+    rows.reserve(tracks.size());
+    for (const auto &view : trackViews()) {
+        rows.append(TrackRows::fromView(view, pool));
+    }
+    return rows;
+}
@@ -0,0 +1,41 @@
+#ifndef SYNTHETICLIBRARY_H
+#define SYNTHETICLIBRARY_H
+
+#include "model.h"
+#include "trackrows.h"
+
+class Database;
+class QCommandLineParser;
+
+// Shape of a generated library. The same spec always produces the same library.
+struct LibrarySpec {
+    int artists         = 1000;
+    int albumsPerArtist = 5;
+    int tracksPerAlbum  = 20;
+    // Share of tracks that list one or two featured artists after the album artist.
+    double featuredRatio = 0.15;
+    unsigned seed        = 42;
+
+    // Adds an option for every field to parser, defaulting to the values of this spec.
+    void addOptions(QCommandLineParser &parser) const;
+    // The spec given by the options addOptions() added; parser must have processed them.
+    static LibrarySpec fromParser(const QCommandLineParser &parser);
+};
+
+struct SyntheticLibrary {
+    GMArtistList artists;
+    GMAlbumList albums;
+    GMTrackList tracks;
+
+    static SyntheticLibrary generate(const LibrarySpec &spec);
+
+    // Writes the library to db, whose tables must exist.
+    bool store(Database &db) const;
+
+    // The tracks as the TrackView table would return them.
+    GMTrackViewList trackViews() const;
+    // The tracks as TrackListModel holds them, with their strings interned in pool.
+    TrackRowList trackRows(StringPool &pool) const;
+};
+
+#endif // SYNTHETICLIBRARY_H
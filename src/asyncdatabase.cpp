@@ -0,0 +1,35 @@
+#include "asyncdatabase.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThreadPool>
+
+AsyncDatabase::AsyncDatabase(QObject *parent)
+    : QObject(parent), db_(std::make_shared<Database>())
+{
+}
+
+void AsyncDatabase::setDatabasePath(const QString &path)
+{
+    run([path](Database &db) {
+        if (!db.openConnection(path)) {
+            qWarning() << "could not open database at" << path;
+            return false;
+        }
+        return true;
+    });
+}
+
+// A pool with a single thread that never expires is the database thread: all actions share one
+// connection and are serialized. The pool is owned by the application, so the thread and its
+// connections are torn down while Qt is still alive.
+QThreadPool *AsyncDatabase::threadPool()
+{
+    static QThreadPool *pool = [] {
+        auto pool = new QThreadPool(QCoreApplication::instance());
+        pool->setMaxThreadCount(1);
+        pool->setExpiryTimeout(-1);
+        return pool;
+    }();
+    return pool;
+}
@@ -0,0 +1,88 @@
+#ifndef ASYNCDATABASE_H
+#define ASYNCDATABASE_H
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QtConcurrent>
+#include <memory>
+#include <type_traits>
+
+#include "database.h"
+
+class QThreadPool;
+
+/*
+ * Asynchronous facade over Database. Every action runs on a single dedicated database thread,
+ * which therefore owns its own connection; results are delivered back on the thread this object
+ * lives in. Actions of all instances are executed one at a time, in submission order.
+ */
+class AsyncDatabase : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AsyncDatabase(QObject *parent = nullptr);
+
+    void setDatabasePath(const QString &path);
+
+    template <class Action> auto run(Action action)
+    {
+        auto db = db_;
+        return QtConcurrent::run(threadPool(), [db, action]() { return action(*db); });
+    }
+
+    // Runs action on the database thread and passes its result to callback on this object's
+    // thread. The callback is dropped if this object is destroyed first.
+    template <class Action, class Callback> void run(Action action, Callback callback)
+    {
+        using Result = std::invoke_result_t<Action, Database &>;
+        auto watcher = new QFutureWatcher<Result>(this);
+        connect(watcher, &QFutureWatcherBase::finished, this, [watcher, callback]() {
+            callback(watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(run(action));
+    }
+
+    // Runs action(db, interface) on the database thread. The action reports partial results
+    // through interface and should stop once interface.isCanceled(); each result is passed to
+    // onResult on this object's thread, then onFinished(canceled) is called. Cancel the returned
+    // future to abandon the action.
+    template <class T, class Action, class OnResult, class OnFinished>
+    QFuture<T> stream(Action action, OnResult onResult, OnFinished onFinished)
+    {
+        QFutureInterface<T> interface;
+        interface.reportStarted();
+
+        auto watcher = new QFutureWatcher<T>(this);
+        connect(watcher, &QFutureWatcherBase::resultsReadyAt, this,
+                [watcher, onResult](int begin, int end) {
+                    for (int i = begin; i < end; ++i) {
+                        onResult(watcher->resultAt(i));
+                    }
+                });
+        connect(watcher, &QFutureWatcherBase::finished, this, [watcher, onFinished]() {
+            onFinished(watcher->isCanceled());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(interface.future());
+
+        run([action, interface](Database &db) {
+            QFutureInterface<T> promise(interface);
+            if (!promise.isCanceled()) {
+                action(db, promise);
+            }
+            promise.reportFinished();
+        });
+        return interface.future();
+    }
+
+private:
+    static QThreadPool *threadPool();
+
+    std::shared_ptr<Database> db_;
+};
+
+#endif // ASYNCDATABASE_H
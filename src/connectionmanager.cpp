@@ -0,0 +1,148 @@
+#include "connectionmanager.h"
+
+#include <QDebug>
+#include <QSqlError>
+
+#include "utils.h"
+
+#define BUSY_TIMEOUT_MS 5000
+
+struct ThreadConnection {
+    QSqlDatabase db;
+    QHash<int, QSqlQuery> statements;
+    // PRAGMA schema_version when the statements were last validated, -1 before.
+    int schemaVersion;
+};
+
+class ThreadConnections
+{
+public:
+    ~ThreadConnections()
+    {
+        for (const auto &path : connections.keys()) {
+            remove(path);
+        }
+    }
+
+    void remove(const QString &path)
+    {
+        auto it = connections.find(path);
+        if (it == connections.end()) {
+            return;
+        }
+        QString connName = it->db.connectionName();
+        it->statements.clear();
+        it->db.close();
+        connections.erase(it);
+        QSqlDatabase::removeDatabase(connName);
+    }
+
+    QHash<QString, ThreadConnection> connections;
+};
+
+CachedQuery DBConnection::statement(int id, const QString &sql)
+{
+    auto &statements = statements_ ? *statements_ : uncachedStatements_;
+    auto it          = statements.find(id);
+    if (it == statements.end()) {
+        QSqlQuery query(db_);
+        query.setForwardOnly(true);
+        if (!query.prepare(sql)) {
+            qWarning() << "could not prepare statement" << sql << ":" << query.lastError();
+        }
+        it = statements.insert(id, query);
+    }
+    return CachedQuery(it.value());
+}
+
+void DBConnection::validateStatements()
+{
+    QSqlQuery query(db_);
+    if (!query.exec(QStringLiteral("PRAGMA schema_version")) || !query.next()) {
+        qWarning() << "could not read schema version:" << query.lastError();
+        clearStatements();
+        return;
+    }
+    int version = query.value(0).toInt();
+    if (schemaVersion_ && *schemaVersion_ != version) {
+        clearStatements();
+        *schemaVersion_ = version;
+    }
+}
+
+void DBConnection::clearStatements()
+{
+    if (statements_) {
+        statements_->clear();
+    }
+}
+
+static bool configureConnection(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    if (!query.exec(QStringLiteral("PRAGMA journal_mode=WAL"))) {
+        qWarning() << "could not enable WAL journal mode:" << query.lastError();
+        return false;
+    }
+    if (!query.exec(QStringLiteral("PRAGMA synchronous=NORMAL"))) {
+        qWarning() << "could not set synchronous mode:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+ConnectionManager &ConnectionManager::instance()
+{
+    static ConnectionManager manager;
+    return manager;
+}
+
+DBConnection ConnectionManager::connection(const QString &path)
+{
+    if (path.isEmpty()) {
+        return DBConnection();
+    }
+    if (!connections_.hasLocalData()) {
+        connections_.setLocalData(new ThreadConnections);
+    }
+    auto &threadConnections = connections_.localData()->connections;
+
+    auto it = threadConnections.find(path);
+    if (it != threadConnections.end()) {
+        return DBConnection(it->db, &it->statements, &it->schemaVersion);
+    }
+
+    QString connName = QStringLiteral("%1@%2").arg(path, Utils::ThreadId());
+    QSqlDatabase db  = QSqlDatabase::addDatabase("QSQLITE", connName);
+    db.setDatabaseName(path);
+    db.setConnectOptions(QStringLiteral("QSQLITE_BUSY_TIMEOUT=%1").arg(BUSY_TIMEOUT_MS));
+    if (!db.open()) {
+        qWarning() << "Could not open database" << path << ":" << db.lastError().text();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connName);
+        return DBConnection();
+    }
+    if (!configureConnection(db)) {
+        qWarning() << "Could not configure database connection for" << path;
+    }
+    it = threadConnections.insert(path, ThreadConnection{db, {}, -1});
+    return DBConnection(it->db, &it->statements, &it->schemaVersion);
+}
+
+void ConnectionManager::clearStatements(const QString &path)
+{
+    if (!connections_.hasLocalData()) {
+        return;
+    }
+    auto &threadConnections = connections_.localData()->connections;
+    auto it                 = threadConnections.find(path);
+    if (it != threadConnections.end()) {
+        it->statements.clear();
+    }
+}
+
+std::mutex &ConnectionManager::writeMutex(const QString &path)
+{
+    std::lock_guard<std::mutex> guard(writeMutexesGuard_);
+    return writeMutexes_[path];
+}
@@ -0,0 +1,108 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QThreadStorage>
+#include <map>
+#include <mutex>
+
+class ThreadConnections;
+
+/*
+ * Prepared statement borrowed from a connection's statement cache. The statement is reset when
+ * the borrower goes out of scope, so a partially read result never pins a WAL snapshot.
+ */
+class CachedQuery
+{
+public:
+    explicit CachedQuery(QSqlQuery &query) : query_(query)
+    {
+    }
+    CachedQuery(const CachedQuery &) = delete;
+    CachedQuery &operator=(const CachedQuery &) = delete;
+
+    ~CachedQuery()
+    {
+        query_.finish();
+    }
+
+    QSqlQuery &operator*() const
+    {
+        return query_;
+    }
+    QSqlQuery *operator->() const
+    {
+        return &query_;
+    }
+
+private:
+    QSqlQuery &query_;
+};
+
+/*
+ * The calling thread's connection to a database file together with its prepared statement
+ * cache. Only valid for the duration of a single Database call.
+ */
+class DBConnection
+{
+public:
+    DBConnection() = default;
+    DBConnection(const QSqlDatabase &db, QHash<int, QSqlQuery> *statements, int *schemaVersion)
+        : db_(db), statements_(statements), schemaVersion_(schemaVersion)
+    {
+    }
+    DBConnection(const DBConnection &) = delete;
+    DBConnection &operator=(const DBConnection &) = delete;
+
+    QSqlDatabase &db()
+    {
+        return db_;
+    }
+
+    // Returns the statement cached under id, preparing sql on first use.
+    CachedQuery statement(int id, const QString &sql);
+    // The statements cached so far.
+    QList<QSqlQuery> statements() const
+    {
+        return statements_ ? statements_->values() : QList<QSqlQuery>();
+    }
+    // Drops the cached statements if the schema changed since they were prepared.
+    void validateStatements();
+    void clearStatements();
+
+private:
+    QSqlDatabase db_;
+    QHash<int, QSqlQuery> *statements_ = nullptr;
+    int *schemaVersion_                = nullptr;
+    QHash<int, QSqlQuery> uncachedStatements_;
+};
+
+/*
+ * Hands out one SQLite connection per (thread, database file). Connections are opened in WAL
+ * mode, so readers on one thread never wait for a writer on another one; writers are serialized
+ * through writeMutex(). A thread's connections are closed when the thread exits.
+ */
+class ConnectionManager
+{
+public:
+    static ConnectionManager &instance();
+    ConnectionManager(const ConnectionManager &) = delete;
+    ConnectionManager &operator=(const ConnectionManager &) = delete;
+
+    DBConnection connection(const QString &path);
+    // Drops the statements the calling thread has cached for path, if it has a connection to it.
+    void clearStatements(const QString &path);
+    std::mutex &writeMutex(const QString &path);
+
+private:
+    ConnectionManager() = default;
+
+    QThreadStorage<ThreadConnections *> connections_;
+    std::mutex writeMutexesGuard_;
+    std::map<QString, std::mutex> writeMutexes_;
+};
+
+#endif // CONNECTIONMANAGER_H
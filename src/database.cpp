@@ -1,13 +1,56 @@
 #include "database.h"
 
+#include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QThread>
 
 #include "utils.h"
 
-static QString CONNECTION_NAME = QStringLiteral("DEFAULT_CONNECTION");
+// Keys of the per-connection prepared statement cache.
+enum QueryId {
+    TracksQuery,
+    TrackArtistsQuery,
+    TracksPageQuery,
+    TrackArtistsPageQuery,
+    TracksForAlbumQuery,
+    TrackArtistsForAlbumQuery,
+    TracksForArtistQuery,
+    TrackArtistsForArtistQuery,
+    TrackQuery,
+    ArtistsForTrackQuery,
+    InsertTrackQuery,
+    InsertTrackArtistQuery,
+    RemoveTrackArtistsQuery,
+    RemoveTrackQuery,
+    ArtistsQuery,
+    ArtistQuery,
+    InsertArtistQuery,
+    AlbumsQuery,
+    AlbumArtistsQuery,
+    AlbumsForArtistQuery,
+    AlbumArtistsForArtistQuery,
+    AlbumQuery,
+    ArtistsForAlbumQuery,
+    InsertAlbumQuery,
+    InsertAlbumArtistQuery,
+    SearchTracksQuery,
+    InsertTrackSearchQuery,
+    RemoveTrackSearchQuery,
+    UpdateAlbumSearchQuery,
+    UpdateArtistSearchQuery,
+    TrackViewsQuery,
+    TrackViewsForAlbumQuery,
+    TrackViewsForArtistQuery,
+    InsertTrackViewQuery,
+    RemoveTrackViewQuery,
+    UpdateAlbumViewQuery,
+    UpdateArtistViewQuery,
+    TrackViewsFirstPageQuery,
+    TrackViewsPageQuery,
+};
 
 Database::Database(QObject *parent) : QObject(parent)
 {
@@ -17,40 +60,49 @@ Database::~Database()
 {
 }
 
-bool Database::openConnection(const QString &path, QString connName)
+// Debug instrumentation: the GUI thread talks to the database through AsyncDatabase only.
+void Database::assertNotGuiThread()
 {
-    if (db_.isOpen()) {
-        db_.close();
-    }
-    if (!QSqlDatabase::contains(connName)) {
-        db_ = QSqlDatabase::addDatabase("QSQLITE", connName);
-    } else {
-        db_ = QSqlDatabase::database(connName);
+    auto app = QCoreApplication::instance();
+    Q_ASSERT_X(!app || !app->inherits("QGuiApplication") ||
+                   QThread::currentThread() != app->thread(),
+               "Database", "SQLite accessed from the GUI thread, use AsyncDatabase instead");
+    Q_UNUSED(app);
+}
+
+bool Database::openConnection(const QString &path)
+{
+    assertNotGuiThread();
+    auto &manager = ConnectionManager::instance();
+    if (!path_.isEmpty() && path_ != path) {
+        manager.clearStatements(path_);
     }
-    db_.setDatabaseName(path);
-    if (!db_.open()) {
-        qWarning() << "Could not open database" << path << ":" << db_.lastError().text();
+    path_ = path;
+    // Every Database on a thread shares the thread's connection to path. An open connection is
+    // kept instead of being reopened, and so are its statements unless the schema changed.
+    DBConnection conn = manager.connection(path_);
+    if (!conn.db().isOpen()) {
         return false;
     }
+    conn.validateStatements();
     return true;
 }
 
-bool Database::createSchema_(QSqlDatabase &db)
+// Initial schema. Databases created before versioning was introduced already have these tables
+// and report user_version 0, so every statement must be idempotent.
+static bool migrateToVersion1(QSqlQuery &query)
 {
-    QSqlQuery query(db);
-    DBTransaction transaction(db);
-
     if (!query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS Artist(id TEXT "
                                    "PRIMARY KEY, name TEXT, artUrl TEXT, bio "
                                    "TEXT)"))) {
-        qWarning() << db.lastError();
+        qWarning() << query.lastError();
         return false;
     }
 
     if (!query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS Album(id TEXT "
                                    "PRIMARY KEY, name TEXT, artUrl TEXT, descr "
                                    "TEXT, year INTEGER)"))) {
-        qWarning() << db.lastError();
+        qWarning() << query.lastError();
         return false;
     }
 
@@ -63,7 +115,7 @@ bool Database::createSchema_(QSqlDatabase &db)
                                    "year INTEGER,"
                                    "trackType TEXT,"
                                    "size INTEGER)"))) {
-        qWarning() << db.lastError();
+        qWarning() << query.lastError();
         return false;
     }
 
@@ -72,7 +124,7 @@ bool Database::createSchema_(QSqlDatabase &db)
                                    "trackId REFERENCES Track(id), "
                                    "artistId REFERENCES Artist(id),"
                                    "PRIMARY KEY(trackId, artistId))"))) {
-        qWarning() << db.lastError();
+        qWarning() << query.lastError();
         return false;
     }
 
@@ -81,59 +133,490 @@ bool Database::createSchema_(QSqlDatabase &db)
                                    "artistId REFERENCES Artist(id), "
                                    "albumId REFERENCES Album(id),"
                                    "PRIMARY KEY(artistId, albumId))"))) {
-        qWarning() << db.lastError();
+        qWarning() << query.lastError();
         return false;
     }
 
-    transaction.commit();
+    return true;
+}
+
+// Secondary indexes for the join columns not covered by a primary key prefix.
+static bool migrateToVersion2(QSqlQuery &query)
+{
+    if (!query.exec(QStringLiteral("CREATE INDEX IF NOT EXISTS Track_albumId ON Track(albumId)"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(QStringLiteral(
+            "CREATE INDEX IF NOT EXISTS Track2Artist_artistId ON Track2Artist(artistId)"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(QStringLiteral(
+            "CREATE INDEX IF NOT EXISTS Artist2Album_albumId ON Artist2Album(albumId)"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
 
     return true;
 }
 
-std::optional<GMTrackList> Database::tracks_(QSqlDatabase &db)
+// Builds the search row of the tracks selected by the trailing WHERE clause.
+#define TRACK_SEARCH_INSERT                                                                        \
+    "INSERT INTO TrackSearch(rowid, title, album, artist) "                                        \
+    "SELECT t.rowid, t.name, COALESCE((SELECT name FROM Album WHERE id = t.albumId), ''), "        \
+    "COALESCE((SELECT group_concat(a.name, ' ') FROM Track2Artist ta JOIN Artist a ON "            \
+    "a.id = ta.artistId WHERE ta.trackId = t.id), '') FROM Track t"
+
+// Full-text index over track titles, album names and artist names. Search rows share their rowid
+// with the Track row they describe and are kept up to date by the insert and remove methods.
+static bool migrateToVersion3(QSqlQuery &query)
 {
-    QSqlQuery query(db);
+    if (!query.exec(QStringLiteral("CREATE VIRTUAL TABLE IF NOT EXISTS TrackSearch USING "
+                                   "fts5(title, album, artist, prefix = '2 3')"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(QStringLiteral(TRACK_SEARCH_INSERT))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    return true;
+}
+
+// Fills TrackView rows for the (trackId, artistId) pairs selected by primaryArtists, artistId being
+// the track's primary artist.
+#define TRACK_VIEW_INSERT(primaryArtists)                                                          \
+    "INSERT OR REPLACE INTO TrackView (trackId, albumId, artistId, title, genre, duration, "       \
+    "trackNumber, year, trackType, size, albumName, albumYear, albumArtUrl, artistName, "          \
+    "artistArtUrl) SELECT t.id, t.albumId, p.artistId, t.name, t.genre, t.duration, "              \
+    "t.trackNumber, t.year, t.trackType, t.size, COALESCE(al.name, ''), al.year, al.artUrl, "      \
+    "COALESCE(ar.name, ''), ar.artUrl FROM (" primaryArtists ") p JOIN Track t ON "                \
+    "t.id = p.trackId LEFT JOIN Album al ON al.id = t.albumId LEFT JOIN Artist ar ON "             \
+    "ar.id = p.artistId"
+
+#define TRACK_VIEW_COLUMNS                                                                         \
+    "trackId, albumId, artistId, title, genre, duration, trackNumber, year, trackType, size, "     \
+    "albumName, albumYear, albumArtUrl, artistName, artistArtUrl"
+
+// Denormalised read table holding each track with the names and art of its album and primary
+// artist, so the track list loads with a single query. Kept in sync by the insert and remove
+// methods.
+static bool migrateToVersion4(QSqlQuery &query)
+{
+    if (!query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS TrackView(trackId TEXT PRIMARY "
+                                   "KEY, albumId TEXT, artistId TEXT, title TEXT, genre TEXT, "
+                                   "duration INTEGER, trackNumber INTEGER, year INTEGER, "
+                                   "trackType TEXT, size INTEGER, albumName TEXT, albumYear "
+                                   "INTEGER, albumArtUrl TEXT, artistName TEXT, artistArtUrl "
+                                   "TEXT)"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(
+            QStringLiteral("CREATE INDEX IF NOT EXISTS TrackView_albumId ON TrackView(albumId)"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
     if (!query.exec(QStringLiteral(
-            "SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, size "
-            "from Track"))) {
+            "CREATE INDEX IF NOT EXISTS TrackView_artistId ON TrackView(artistId)"))) {
         qWarning() << query.lastError();
-        return std::nullopt;
+        return false;
+    }
+
+    // The order of a track's artists is not stored at this version; the link with the lowest rowid
+    // is the best guess. Migration 6 records the order.
+    if (!query.exec(QStringLiteral(TRACK_VIEW_INSERT(
+            "SELECT id AS trackId, (SELECT artistId FROM Track2Artist WHERE trackId = Track.id "
+            "ORDER BY rowid LIMIT 1) AS artistId FROM Track")))) {
+        qWarning() << query.lastError();
+        return false;
     }
-    return extractTracks(db, query);
+
+    return true;
 }
 
-Opt<GMTrackList> Database::tracks_for_album(QSqlDatabase &db, const QString &albumId)
+// Display order of the track table, approximated with SQLite's NOCASE collation.
+#define TRACK_VIEW_ORDER "artistName COLLATE NOCASE, albumName COLLATE NOCASE, trackNumber, trackId"
+
+// Index backing trackViewsPage(). Names become empty strings instead of NULL so that the row value
+// comparison of the page query never yields NULL.
+static bool migrateToVersion5(QSqlQuery &query)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral(
-        "SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, size "
-        "FROM Track WHERE albumId = :albumId"));
-    query.bindValue(":albumId", albumId);
-    if (!query.exec()) {
+    if (!query.exec(QStringLiteral("UPDATE TrackView SET artistName = COALESCE(artistName, ''), "
+                                   "albumName = COALESCE(albumName, '') WHERE artistName IS NULL "
+                                   "OR albumName IS NULL"))) {
         qWarning() << query.lastError();
-        return std::nullopt;
+        return false;
     }
-    return extractTracks(db, query);
+
+    if (!query.exec(QStringLiteral("CREATE INDEX IF NOT EXISTS TrackView_order ON "
+                                   "TrackView(" TRACK_VIEW_ORDER ")"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    return true;
 }
 
-Opt<GMTrackList> Database::tracks_for_artist(QSqlDatabase &db, const QString &artistId)
+// Records the order of a track's artists, position 0 being the primary artist shown in TrackView.
+// REPLACE gave rewritten links new rowids and left links of dropped artists in place, so the
+// artist TrackView shows comes first and the others keep their rowid order.
+static bool migrateToVersion6(QSqlQuery &query)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral(
-        "SELECT a.id, a.albumId, a.name, a.genre, a.duration, a.trackNumber, a.year, a.trackType, "
-        "a.size "
-        "FROM Track a JOIN Track2Artist b on (a.id = b.trackId) and b.artistId = :artistId"));
-    query.bindValue(":artistId", artistId);
-    if (!query.exec()) {
+    if (!query.exec(QStringLiteral(
+            "ALTER TABLE Track2Artist ADD COLUMN position INTEGER NOT NULL DEFAULT 0"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(QStringLiteral(
+            "UPDATE Track2Artist SET position = CASE WHEN artistId IS (SELECT artistId FROM "
+            "TrackView WHERE trackId = Track2Artist.trackId) THEN 0 ELSE 1 + (SELECT COUNT(*) "
+            "FROM Track2Artist b WHERE b.trackId = Track2Artist.trackId AND "
+            "b.rowid < Track2Artist.rowid) END"))) {
+        qWarning() << query.lastError();
+        return false;
+    }
+
+    if (!query.exec(QStringLiteral("CREATE INDEX IF NOT EXISTS Track2Artist_position ON "
+                                   "Track2Artist(trackId, position, artistId)"))) {
         qWarning() << query.lastError();
+        return false;
+    }
+
+    return true;
+}
+
+// Migration i brings the schema from user_version i to i + 1. New migrations are only ever
+// appended.
+using Migration = bool (*)(QSqlQuery &);
+static const Migration MIGRATIONS[] = {migrateToVersion1, migrateToVersion2, migrateToVersion3,
+                                       migrateToVersion4, migrateToVersion5, migrateToVersion6};
+
+// Turns text typed by the user into an FTS5 query that matches every word as a prefix.
+static QString ftsQuery(const QString &text)
+{
+    QStringList terms;
+    for (auto word : text.simplified().split(QLatin1Char(' '), QString::SkipEmptyParts)) {
+        word.remove(QLatin1Char('"'));
+        if (!word.isEmpty()) {
+            terms.append(QStringLiteral("\"%1\"*").arg(word));
+        }
+    }
+    return terms.join(QLatin1Char(' '));
+}
+
+bool Database::createSchema_(DBConnection &conn)
+{
+    QSqlDatabase &db = conn.db();
+    QSqlQuery query(db);
+
+    if (!query.exec(QStringLiteral("PRAGMA user_version")) || !query.next()) {
+        qWarning() << "could not read schema version:" << query.lastError();
+        return false;
+    }
+    const int currentVersion = query.value(0).toInt();
+    const int targetVersion  = sizeof(MIGRATIONS) / sizeof(MIGRATIONS[0]);
+    query.finish();
+
+    if (currentVersion > targetVersion) {
+        qWarning() << "database schema version" << currentVersion
+                   << "is newer than the supported version" << targetVersion;
+        return false;
+    }
+
+    for (int version = currentVersion; version < targetVersion; ++version) {
+        DBTransaction transaction(db);
+        if (!MIGRATIONS[version](query)) {
+            qWarning() << "could not migrate database schema to version" << version + 1;
+            return false;
+        }
+        if (!query.exec(QStringLiteral("PRAGMA user_version = %1").arg(version + 1))) {
+            qWarning() << query.lastError();
+            return false;
+        }
+        transaction.commit();
+    }
+    // Statements prepared before a migration may read tables it changed.
+    conn.validateStatements();
+
+    return true;
+}
+
+// Explains every statement prepared on conn with the values last bound to it, as the lines of
+// EXPLAIN QUERY PLAN keyed by the statement's SQL.
+Opt<QHash<QString, QStringList>> Database::query_plans(DBConnection &conn)
+{
+    QHash<QString, QStringList> plans;
+    for (const auto &statement : conn.statements()) {
+        QSqlQuery query(conn.db());
+        if (!query.prepare(QStringLiteral("EXPLAIN QUERY PLAN ") + statement.lastQuery())) {
+            qWarning() << query.lastError();
+            return std::nullopt;
+        }
+        const auto values = statement.boundValues();
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+            query.bindValue(it.key(), it.value());
+        }
+        if (!query.exec()) {
+            qWarning() << query.lastError();
+            return std::nullopt;
+        }
+
+        QStringList details;
+        while (query.next()) {
+            details.append(query.value(3).toString());
+        }
+        plans.insert(statement.lastQuery(), details);
+    }
+    return std::move(plans);
+}
+
+std::optional<GMTrackList> Database::tracks_(DBConnection &conn)
+{
+    auto query = conn.statement(
+        TracksQuery,
+        QStringLiteral("SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, "
+                       "size from Track"));
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return std::nullopt;
+    }
+
+    auto artistQuery = conn.statement(
+        TrackArtistsQuery,
+        QStringLiteral("SELECT trackId, artistId FROM Track2Artist ORDER BY trackId, position"));
+    if (!artistQuery->exec()) {
+        qWarning() << "could not extract artists for tracks:" << artistQuery->lastError();
+        return std::nullopt;
+    }
+    return extractTracks(*query, *artistQuery);
+}
+
+// Keyset pagination: returns up to limit tracks ordered by id whose id sorts after afterId.
+Opt<GMTrackList> Database::tracks_page(DBConnection &conn, const QString &afterId, int limit)
+{
+    auto query = conn.statement(
+        TracksPageQuery,
+        QStringLiteral("SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, "
+                       "size FROM Track WHERE id > :afterId ORDER BY id LIMIT :limit"));
+    query->bindValue(":afterId", afterId);
+    query->bindValue(":limit", limit);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return std::nullopt;
+    }
+
+    auto artistQuery = conn.statement(
+        TrackArtistsPageQuery,
+        QStringLiteral("SELECT trackId, artistId FROM Track2Artist WHERE trackId IN "
+                       "(SELECT id FROM Track WHERE id > :afterId ORDER BY id LIMIT :limit) "
+                       "ORDER BY trackId, position"));
+    artistQuery->bindValue(":afterId", afterId);
+    artistQuery->bindValue(":limit", limit);
+    if (!artistQuery->exec()) {
+        qWarning() << "could not extract artists for tracks:" << artistQuery->lastError();
+        return std::nullopt;
+    }
+    return extractTracks(*query, *artistQuery);
+}
+
+Opt<GMTrackList> Database::tracks_for_album(DBConnection &conn, const QString &albumId)
+{
+    auto query = conn.statement(
+        TracksForAlbumQuery,
+        QStringLiteral("SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, "
+                       "size FROM Track WHERE albumId = :albumId"));
+    query->bindValue(":albumId", albumId);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return std::nullopt;
+    }
+
+    auto artistQuery = conn.statement(
+        TrackArtistsForAlbumQuery,
+        QStringLiteral("SELECT b.trackId, b.artistId FROM Track2Artist b JOIN Track a ON "
+                       "(a.id = b.trackId) WHERE a.albumId = :albumId "
+                       "ORDER BY b.trackId, b.position"));
+    artistQuery->bindValue(":albumId", albumId);
+    if (!artistQuery->exec()) {
+        qWarning() << "could not extract artists for tracks:" << artistQuery->lastError();
         return std::nullopt;
     }
-    return extractTracks(db, query);
+    return extractTracks(*query, *artistQuery);
+}
+
+Opt<GMTrackList> Database::tracks_for_artist(DBConnection &conn, const QString &artistId)
+{
+    auto query = conn.statement(
+        TracksForArtistQuery,
+        QStringLiteral("SELECT a.id, a.albumId, a.name, a.genre, a.duration, a.trackNumber, "
+                       "a.year, a.trackType, a.size FROM Track a JOIN Track2Artist b on "
+                       "(a.id = b.trackId) and b.artistId = :artistId"));
+    query->bindValue(":artistId", artistId);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return std::nullopt;
+    }
+
+    auto artistQuery = conn.statement(
+        TrackArtistsForArtistQuery,
+        QStringLiteral("SELECT b.trackId, b.artistId FROM Track2Artist b JOIN Track2Artist c ON "
+                       "(b.trackId = c.trackId) WHERE c.artistId = :artistId "
+                       "ORDER BY b.trackId, b.position"));
+    artistQuery->bindValue(":artistId", artistId);
+    if (!artistQuery->exec()) {
+        qWarning() << "could not extract artists for tracks:" << artistQuery->lastError();
+        return std::nullopt;
+    }
+    return extractTracks(*query, *artistQuery);
+}
+
+// Visits the display rows of up to limit tracks matching text, picking the best matches first.
+bool Database::search_(DBConnection &conn, const QString &text, int limit,
+                       const TrackViewVisitor &visitor)
+{
+    QString match = ftsQuery(text);
+    if (match.isEmpty()) {
+        return true;
+    }
+
+    auto query = conn.statement(
+        SearchTracksQuery,
+        QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView WHERE trackId IN "
+                       "(SELECT t.id FROM TrackSearch s JOIN Track t ON t.rowid = s.rowid "
+                       "WHERE TrackSearch MATCH :match ORDER BY s.rank LIMIT :limit) "
+                       "ORDER BY " TRACK_VIEW_ORDER));
+    query->bindValue(":match", match);
+    query->bindValue(":limit", limit);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return false;
+    }
+    return visitTrackViews(*query, visitor);
+}
+
+bool Database::track_views(DBConnection &conn, const TrackViewVisitor &visitor)
+{
+    auto query = conn.statement(TrackViewsQuery,
+                                QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView "
+                                               "ORDER BY " TRACK_VIEW_ORDER));
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return false;
+    }
+    return visitTrackViews(*query, visitor);
+}
+
+// Keyset pagination in display order: visits up to limit rows following after, or the first rows
+// when after is not set.
+bool Database::track_views_page(DBConnection &conn, const Opt<TrackViewCursor> &after, int limit,
+                                const TrackViewVisitor &visitor)
+{
+    if (!after) {
+        auto query = conn.statement(TrackViewsFirstPageQuery,
+                                    QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView "
+                                                   "ORDER BY " TRACK_VIEW_ORDER " LIMIT :limit"));
+        query->bindValue(":limit", limit);
+        if (!query->exec()) {
+            qWarning() << query->lastError();
+            return false;
+        }
+        return visitTrackViews(*query, visitor);
+    }
+
+    // The leading artist bound lets SQLite seek in TrackView_order instead of scanning it.
+    auto query = conn.statement(
+        TrackViewsPageQuery,
+        QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView WHERE artistName COLLATE "
+                       "NOCASE >= :artist AND (" TRACK_VIEW_ORDER ") > (:artist2, :album, "
+                       ":number, :trackId) ORDER BY " TRACK_VIEW_ORDER " LIMIT :limit"));
+    query->bindValue(":artist", after->artistName);
+    query->bindValue(":artist2", after->artistName);
+    query->bindValue(":album", after->albumName);
+    query->bindValue(":number", after->trackNumber);
+    query->bindValue(":trackId", after->trackId);
+    query->bindValue(":limit", limit);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return false;
+    }
+    return visitTrackViews(*query, visitor);
+}
+
+bool Database::track_views_for_album(DBConnection &conn, const QString &albumId,
+                                     const TrackViewVisitor &visitor)
+{
+    auto query = conn.statement(TrackViewsForAlbumQuery,
+                                QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView "
+                                               "WHERE albumId = :albumId "
+                                               "ORDER BY " TRACK_VIEW_ORDER));
+    query->bindValue(":albumId", albumId);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return false;
+    }
+    return visitTrackViews(*query, visitor);
+}
+
+// Includes the tracks where artistId is a featured rather than the primary artist.
+bool Database::track_views_for_artist(DBConnection &conn, const QString &artistId,
+                                      const TrackViewVisitor &visitor)
+{
+    auto query = conn.statement(
+        TrackViewsForArtistQuery,
+        QStringLiteral("SELECT " TRACK_VIEW_COLUMNS " FROM TrackView WHERE trackId IN "
+                       "(SELECT trackId FROM Track2Artist WHERE artistId = :artistId) "
+                       "ORDER BY " TRACK_VIEW_ORDER));
+    query->bindValue(":artistId", artistId);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return false;
+    }
+    return visitTrackViews(*query, visitor);
+}
+
+// query must already be executed and select TRACK_VIEW_COLUMNS. Rows are handed to visitor as
+// the query is stepped, so none are materialised beyond the one being visited.
+bool Database::visitTrackViews(QSqlQuery &query, const TrackViewVisitor &visitor)
+{
+    while (query.next()) {
+        GMTrackView row;
+        row.track.id             = query.value(0).toString();
+        row.track.albumId        = query.value(1).toString();
+        row.track.artistId       = QStringList{query.value(2).toString()};
+        row.track.title          = query.value(3).toString();
+        row.track.genre          = query.value(4).toString();
+        row.track.durationMillis = query.value(5).toLongLong();
+        row.track.trackNumber    = query.value(6).toInt();
+        row.track.year           = query.value(7).toInt();
+        row.track.trackType      = query.value(8).toString();
+        row.track.estimatedSize  = query.value(9).toLongLong();
+        row.albumName            = query.value(10).toString();
+        row.albumYear            = query.value(11).toInt();
+        row.albumArtRef          = query.value(12).toString();
+        row.artistName           = query.value(13).toString();
+        row.artistArtRef         = query.value(14).toString();
+        if (!visitor(row)) {
+            break;
+        }
+    }
+    return true;
 }
 
-Opt<GMTrackList> Database::extractTracks(QSqlDatabase &db, QSqlQuery &query)
+// Both queries must already be executed. artistQuery yields (trackId, artistId) pairs for the
+// tracks selected by query; they are merged in memory instead of querying Track2Artist per row.
+Opt<GMTrackList> Database::extractTracks(QSqlQuery &query, QSqlQuery &artistQuery)
 {
     GMTrackList tracklist;
+    QHash<QString, int> trackIndex;
     while (query.next()) {
         GMTrack track;
         track.id             = query.value(0).toString();
@@ -146,89 +629,130 @@ Opt<GMTrackList> Database::extractTracks(QSqlDatabase &db, QSqlQuery &query)
         track.trackType      = query.value(7).toString();
         track.estimatedSize  = query.value(8).toLongLong();
 
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(
-            QStringLiteral("SELECT artistId FROM Track2Artist WHERE trackId = :trackId"));
-        artistQuery.bindValue(":trackId", track.id);
-        if (!artistQuery.exec()) {
-            qWarning() << "could not extract artists for track:" << db.lastError();
-        }
-        while (artistQuery.next()) {
-            track.artistId.append(artistQuery.value(0).toString());
-        }
+        trackIndex.insert(track.id, tracklist.size());
         tracklist.append(track);
     }
+
+    while (artistQuery.next()) {
+        auto it = trackIndex.constFind(artistQuery.value(0).toString());
+        if (it != trackIndex.constEnd()) {
+            tracklist[it.value()].artistId.append(artistQuery.value(1).toString());
+        }
+    }
     return std::move(tracklist);
 }
 
-std::optional<GMTrack> Database::track_(QSqlDatabase &db, const QString &id)
+std::optional<GMTrack> Database::track_(DBConnection &conn, const QString &id)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral(
-        "SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, size "
-        "from Track WHERE id = :trackId"));
-    query.bindValue(":trackId", id);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    auto query = conn.statement(
+        TrackQuery,
+        QStringLiteral("SELECT id, albumId, name, genre, duration, trackNumber, year, trackType, "
+                       "size from Track WHERE id = :trackId"));
+    query->bindValue(":trackId", id);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
     GMTrack track;
-    if (query.next()) {
-        track.id             = query.value(0).toString();
-        track.albumId        = query.value(1).toString();
-        track.title          = query.value(2).toString();
-        track.genre          = query.value(3).toString();
-        track.durationMillis = query.value(4).toLongLong();
-        track.trackNumber    = query.value(5).toInt();
-        track.year           = query.value(6).toInt();
-        track.trackType      = query.value(7).toString();
-        track.estimatedSize  = query.value(8).toLongLong();
-
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(
-            QStringLiteral("SELECT artistId FROM Track2Artist WHERE trackId = :trackId"));
-        artistQuery.bindValue(":trackId", track.id);
-        if (!artistQuery.exec()) {
-            qWarning() << "could not get artists for tracks" << artistQuery.lastError();
+    if (query->next()) {
+        track.id             = query->value(0).toString();
+        track.albumId        = query->value(1).toString();
+        track.title          = query->value(2).toString();
+        track.genre          = query->value(3).toString();
+        track.durationMillis = query->value(4).toLongLong();
+        track.trackNumber    = query->value(5).toInt();
+        track.year           = query->value(6).toInt();
+        track.trackType      = query->value(7).toString();
+        track.estimatedSize  = query->value(8).toLongLong();
+
+        auto artistQuery = conn.statement(
+            ArtistsForTrackQuery,
+            QStringLiteral("SELECT artistId FROM Track2Artist WHERE trackId = :trackId "
+                           "ORDER BY position"));
+        artistQuery->bindValue(":trackId", track.id);
+        if (!artistQuery->exec()) {
+            qWarning() << "could not get artists for tracks" << artistQuery->lastError();
         }
-        while (artistQuery.next()) {
-            track.artistId.append(artistQuery.value(0).toString());
+        while (artistQuery->next()) {
+            track.artistId.append(artistQuery->value(0).toString());
         }
     }
     return std::move(track);
 }
 
-bool Database::insertTrack_(QSqlDatabase &db, const GMTrack &track)
+bool Database::insertTracks_(DBConnection &conn, const GMTrackList &tracks)
 {
-    DBTransaction transaction(db);
-    QSqlQuery query(db);
-    query.prepare(
+    DBTransaction transaction(conn.db());
+    auto query = conn.statement(
+        InsertTrackQuery,
         QStringLiteral("INSERT OR REPLACE INTO Track (id, albumId, name, genre, duration, "
                        "trackNumber, year, trackType, size) VALUES (:id, :albumId, :name, :genre, "
                        ":duration, :trackNumber, :year, :trackType, :size)"));
-    query.bindValue(":id", track.id);
-    query.bindValue(":albumId", track.albumId);
-    query.bindValue(":name", track.title);
-    query.bindValue(":genre", track.genre);
-    query.bindValue(":duration", track.durationMillis);
-    query.bindValue(":trackNumber", track.trackNumber);
-    query.bindValue(":year", track.year);
-    query.bindValue(":trackType", track.trackType);
-    query.bindValue(":size", track.estimatedSize);
-
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-        return false;
-    }
+    auto artistQuery = conn.statement(
+        InsertTrackArtistQuery,
+        QStringLiteral("INSERT OR REPLACE INTO Track2Artist (trackId, artistId, position) "
+                       "VALUES(:trackId, :artistId, :position)"));
+    auto removeArtistsQuery = conn.statement(
+        RemoveTrackArtistsQuery,
+        QStringLiteral("DELETE FROM Track2Artist WHERE trackId = :trackId"));
+    auto removeSearchQuery = conn.statement(
+        RemoveTrackSearchQuery, QStringLiteral("DELETE FROM TrackSearch WHERE rowid = "
+                                               "(SELECT rowid FROM Track WHERE id = :trackId)"));
+    auto searchQuery = conn.statement(
+        InsertTrackSearchQuery, QStringLiteral(TRACK_SEARCH_INSERT " WHERE t.id = :trackId"));
+    auto viewQuery = conn.statement(
+        InsertTrackViewQuery,
+        QStringLiteral(TRACK_VIEW_INSERT("SELECT :trackId AS trackId, :artistId AS artistId")));
+
+    for (const auto &track : tracks) {
+        // REPLACE gives the track a new rowid, so its search row is dropped up front.
+        removeSearchQuery->bindValue(":trackId", track.id);
+        if (!removeSearchQuery->exec()) {
+            qWarning() << removeSearchQuery->lastError();
+            return false;
+        }
+
+        query->bindValue(":id", track.id);
+        query->bindValue(":albumId", track.albumId);
+        query->bindValue(":name", track.title);
+        query->bindValue(":genre", track.genre);
+        query->bindValue(":duration", track.durationMillis);
+        query->bindValue(":trackNumber", track.trackNumber);
+        query->bindValue(":year", track.year);
+        query->bindValue(":trackType", track.trackType);
+        query->bindValue(":size", track.estimatedSize);
+
+        if (!query->exec()) {
+            qWarning() << query->lastError();
+            return false;
+        }
+
+        // The links are rewritten, so artists dropped from the track lose theirs.
+        removeArtistsQuery->bindValue(":trackId", track.id);
+        if (!removeArtistsQuery->exec()) {
+            qWarning() << removeArtistsQuery->lastError();
+            return false;
+        }
+        for (int i = 0; i < track.artistId.size(); ++i) {
+            artistQuery->bindValue(":trackId", track.id);
+            artistQuery->bindValue(":artistId", track.artistId[i]);
+            artistQuery->bindValue(":position", i);
+            if (!artistQuery->exec()) {
+                qWarning() << artistQuery->lastError();
+                return false;
+            }
+        }
 
-    for (int i = 0; i < track.artistId.size(); ++i) {
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(QStringLiteral(
-            "INSERT OR REPLACE INTO Track2Artist (trackId, artistId) VALUES(:trackId, :artistId)"));
-        artistQuery.bindValue(":trackId", track.id);
-        artistQuery.bindValue(":artistId", track.artistId[i]);
-        if (!artistQuery.exec()) {
-            qWarning() << artistQuery.lastError();
+        searchQuery->bindValue(":trackId", track.id);
+        if (!searchQuery->exec()) {
+            qWarning() << searchQuery->lastError();
+            return false;
+        }
+
+        viewQuery->bindValue(":trackId", track.id);
+        viewQuery->bindValue(":artistId", track.artistId.value(0));
+        if (!viewQuery->exec()) {
+            qWarning() << viewQuery->lastError();
             return false;
         }
     }
@@ -237,23 +761,41 @@ bool Database::insertTrack_(QSqlDatabase &db, const GMTrack &track)
     return true;
 }
 
-bool Database::removeTrack_(QSqlDatabase &db, const QString &id)
+bool Database::removeTrack_(DBConnection &conn, const QString &id)
 {
-    DBTransaction transaction(db);
-    QSqlQuery query(db);
+    DBTransaction transaction(conn.db());
+
+    auto searchQuery = conn.statement(
+        RemoveTrackSearchQuery, QStringLiteral("DELETE FROM TrackSearch WHERE rowid = "
+                                               "(SELECT rowid FROM Track WHERE id = :trackId)"));
+    searchQuery->bindValue(":trackId", id);
+    if (!searchQuery->exec()) {
+        qWarning() << searchQuery->lastError();
+        return false;
+    }
 
-    query.prepare(QStringLiteral("DELETE FROM Track2Artist WHERE trackId = :trackId"));
-    query.bindValue(":trackId", id);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    auto viewQuery = conn.statement(
+        RemoveTrackViewQuery, QStringLiteral("DELETE FROM TrackView WHERE trackId = :trackId"));
+    viewQuery->bindValue(":trackId", id);
+    if (!viewQuery->exec()) {
+        qWarning() << viewQuery->lastError();
         return false;
     }
 
-    query.finish();
-    query.prepare(QStringLiteral("DELETE FROM Track WHERE id = :trackId"));
-    query.bindValue(":trackId", id);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    auto artistQuery = conn.statement(
+        RemoveTrackArtistsQuery,
+        QStringLiteral("DELETE FROM Track2Artist WHERE trackId = :trackId"));
+    artistQuery->bindValue(":trackId", id);
+    if (!artistQuery->exec()) {
+        qWarning() << artistQuery->lastError();
+        return false;
+    }
+
+    auto query =
+        conn.statement(RemoveTrackQuery, QStringLiteral("DELETE FROM Track WHERE id = :trackId"));
+    query->bindValue(":trackId", id);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return false;
     }
 
@@ -262,78 +804,104 @@ bool Database::removeTrack_(QSqlDatabase &db, const QString &id)
     return true;
 }
 
-std::optional<GMArtistList> Database::artists_(QSqlDatabase &db)
+std::optional<GMArtistList> Database::artists_(DBConnection &conn)
 {
-    QSqlQuery query(db);
-    if (!query.exec(QStringLiteral("SELECT id, name, artUrl, bio FROM Artist"))) {
-        qWarning() << query.lastError();
+    auto query =
+        conn.statement(ArtistsQuery, QStringLiteral("SELECT id, name, artUrl, bio FROM Artist"));
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
 
     GMArtistList result;
-    while (query.next()) {
+    while (query->next()) {
         GMArtist artist;
-        artist.artistId     = query.value(0).toString();
-        artist.name         = query.value(1).toString();
-        artist.artistArtRef = query.value(2).toString();
-        artist.artistBio    = query.value(3).toString();
+        artist.artistId     = query->value(0).toString();
+        artist.name         = query->value(1).toString();
+        artist.artistArtRef = query->value(2).toString();
+        artist.artistBio    = query->value(3).toString();
         result.push_back(artist);
     }
 
     return std::move(result);
 }
 
-std::optional<GMArtist> Database::artist_(QSqlDatabase &db, const QString &id)
+std::optional<GMArtist> Database::artist_(DBConnection &conn, const QString &id)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral("SELECT id, name, artUrl, bio FROM Artist WHERE id = :id"));
-    query.bindValue(":id", id);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    auto query = conn.statement(
+        ArtistQuery, QStringLiteral("SELECT id, name, artUrl, bio FROM Artist WHERE id = :id"));
+    query->bindValue(":id", id);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
 
-    if (!query.next()) {
-        qWarning() << query.lastError();
+    if (!query->next()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
 
     GMArtist artist;
-    artist.artistId     = query.value(0).toString();
-    artist.name         = query.value(1).toString();
-    artist.artistArtRef = query.value(2).toString();
-    artist.artistBio    = query.value(3).toString();
+    artist.artistId     = query->value(0).toString();
+    artist.name         = query->value(1).toString();
+    artist.artistArtRef = query->value(2).toString();
+    artist.artistBio    = query->value(3).toString();
 
     return std::move(artist);
 }
 
-bool Database::insertArtist_(QSqlDatabase &db, const GMArtist &artist)
+bool Database::insertArtists_(DBConnection &conn, const GMArtistList &artists)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral("INSERT OR REPLACE INTO Artist (id, name, artUrl, bio) VALUES "
-                                 "(:id, :name, :artUrl, :bio)"));
-    query.bindValue(":id", artist.artistId);
-    query.bindValue(":name", artist.name);
-    query.bindValue(":artUrl", artist.artistArtRef);
-    query.bindValue(":bio", artist.artistBio);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-        return false;
+    DBTransaction transaction(conn.db());
+    auto query = conn.statement(
+        InsertArtistQuery, QStringLiteral("INSERT OR REPLACE INTO Artist (id, name, artUrl, bio) "
+                                          "VALUES (:id, :name, :artUrl, :bio)"));
+    auto searchQuery = conn.statement(
+        UpdateArtistSearchQuery,
+        QStringLiteral("UPDATE TrackSearch SET artist = (SELECT group_concat(a.name, ' ') FROM "
+                       "Track t JOIN Track2Artist ta ON ta.trackId = t.id JOIN Artist a ON "
+                       "a.id = ta.artistId WHERE t.rowid = TrackSearch.rowid) WHERE rowid IN "
+                       "(SELECT t.rowid FROM Track t JOIN Track2Artist ta ON ta.trackId = t.id "
+                       "WHERE ta.artistId = :artistId)"));
+    auto viewQuery = conn.statement(
+        UpdateArtistViewQuery,
+        QStringLiteral("UPDATE TrackView SET artistName = COALESCE(:name, ''), artistArtUrl = "
+                       ":artUrl WHERE artistId = :artistId"));
+    for (const auto &artist : artists) {
+        query->bindValue(":id", artist.artistId);
+        query->bindValue(":name", artist.name);
+        query->bindValue(":artUrl", artist.artistArtRef);
+        query->bindValue(":bio", artist.artistBio);
+        if (!query->exec()) {
+            qWarning() << query->lastError();
+            return false;
+        }
+
+        searchQuery->bindValue(":artistId", artist.artistId);
+        if (!searchQuery->exec()) {
+            qWarning() << searchQuery->lastError();
+            return false;
+        }
+
+        viewQuery->bindValue(":name", artist.name);
+        viewQuery->bindValue(":artUrl", artist.artistArtRef);
+        viewQuery->bindValue(":artistId", artist.artistId);
+        if (!viewQuery->exec()) {
+            qWarning() << viewQuery->lastError();
+            return false;
+        }
     }
 
+    transaction.commit();
     return true;
 }
 
-std::optional<GMAlbumList> Database::albums_(QSqlDatabase &db)
+// Both queries must already be executed. artistQuery yields (albumId, artistId) pairs for the
+// albums selected by query.
+Opt<GMAlbumList> Database::extractAlbums(QSqlQuery &query, QSqlQuery &artistQuery)
 {
-    QSqlQuery query(db);
-    query.prepare(QStringLiteral("SELECT id, name, artUrl, descr, year FROM Album"));
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-        return std::nullopt;
-    }
-
     GMAlbumList albums;
+    QHash<QString, int> albumIndex;
     while (query.next()) {
         GMAlbum album;
 
@@ -343,125 +911,156 @@ std::optional<GMAlbumList> Database::albums_(QSqlDatabase &db)
         album.description = query.value(3).toString();
         album.year        = query.value(4).toInt();
 
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(
-            QStringLiteral("SELECT artistId FROM Artist2Album WHERE albumId = :albumId"));
-        artistQuery.bindValue(":albumId", album.albumId);
-        if (artistQuery.exec()) {
-            qWarning() << artistQuery.lastError();
-        }
-        while (artistQuery.next()) {
-            album.artistId.append(artistQuery.value(0).toString());
-        }
-
+        albumIndex.insert(album.albumId, albums.size());
         albums.push_back(album);
     }
 
+    while (artistQuery.next()) {
+        auto it = albumIndex.constFind(artistQuery.value(0).toString());
+        if (it != albumIndex.constEnd()) {
+            albums[it.value()].artistId.append(artistQuery.value(1).toString());
+        }
+    }
+
     return std::move(albums);
 }
 
-std::optional<GMAlbumList> Database::albums_for_artist(QSqlDatabase &db, const QString &artistId)
+std::optional<GMAlbumList> Database::albums_(DBConnection &conn)
 {
-    QSqlQuery query(db);
-    query.prepare(
-        QStringLiteral("SELECT a.id, a.name, a.artUrl, a.descr, a.year FROM Album a JOIN "
-                       "Artist2Album b ON (a.id = b.albumId) and (b.artistId = :artistId)"));
-    query.bindValue(":artistId", artistId);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    auto query = conn.statement(
+        AlbumsQuery, QStringLiteral("SELECT id, name, artUrl, descr, year FROM Album"));
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
 
-    GMAlbumList albums;
-    while (query.next()) {
-        GMAlbum album;
+    auto artistQuery = conn.statement(
+        AlbumArtistsQuery,
+        QStringLiteral("SELECT albumId, artistId FROM Artist2Album ORDER BY albumId, artistId"));
+    if (!artistQuery->exec()) {
+        qWarning() << artistQuery->lastError();
+        return std::nullopt;
+    }
 
-        album.albumId     = query.value(0).toString();
-        album.name        = query.value(1).toString();
-        album.albumArtRef = query.value(2).toString();
-        album.description = query.value(3).toString();
-        album.year        = query.value(4).toInt();
+    return extractAlbums(*query, *artistQuery);
+}
 
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(
-            QStringLiteral("SELECT artistId FROM Artist2Album WHERE albumId = :albumId"));
-        artistQuery.bindValue(":albumId", album.albumId);
-        if (!artistQuery.exec()) {
-            qWarning() << artistQuery.lastError();
-        }
-        while (artistQuery.next()) {
-            album.artistId.append(artistQuery.value(0).toString());
-        }
+std::optional<GMAlbumList> Database::albums_for_artist(DBConnection &conn, const QString &artistId)
+{
+    auto query = conn.statement(
+        AlbumsForArtistQuery,
+        QStringLiteral("SELECT a.id, a.name, a.artUrl, a.descr, a.year FROM Album a JOIN "
+                       "Artist2Album b ON (a.id = b.albumId) and (b.artistId = :artistId)"));
+    query->bindValue(":artistId", artistId);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
+        return std::nullopt;
+    }
 
-        albums.push_back(album);
+    auto artistQuery = conn.statement(
+        AlbumArtistsForArtistQuery,
+        QStringLiteral("SELECT b.albumId, b.artistId FROM Artist2Album b JOIN Artist2Album c ON "
+                       "(b.albumId = c.albumId) WHERE c.artistId = :artistId "
+                       "ORDER BY b.albumId, b.artistId"));
+    artistQuery->bindValue(":artistId", artistId);
+    if (!artistQuery->exec()) {
+        qWarning() << artistQuery->lastError();
+        return std::nullopt;
     }
 
-    return std::move(albums);
+    return extractAlbums(*query, *artistQuery);
 }
 
-std::optional<GMAlbum> Database::album_(QSqlDatabase &db, const QString &id)
+std::optional<GMAlbum> Database::album_(DBConnection &conn, const QString &id)
 {
-    QSqlQuery query(db);
-    query.prepare(
+    auto query = conn.statement(
+        AlbumQuery,
         QStringLiteral("SELECT id, name, artUrl, descr, year FROM Album WHERE id = :albumId"));
-    query.bindValue(":albumId", id);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
+    query->bindValue(":albumId", id);
+    if (!query->exec()) {
+        qWarning() << query->lastError();
         return std::nullopt;
     }
 
     GMAlbum album;
-    if (query.next()) {
+    if (query->next()) {
 
-        album.albumId     = query.value(0).toString();
-        album.name        = query.value(1).toString();
-        album.albumArtRef = query.value(2).toString();
-        album.description = query.value(3).toString();
-        album.year        = query.value(4).toInt();
+        album.albumId     = query->value(0).toString();
+        album.name        = query->value(1).toString();
+        album.albumArtRef = query->value(2).toString();
+        album.description = query->value(3).toString();
+        album.year        = query->value(4).toInt();
 
-        QSqlQuery artistQuery(db);
-        artistQuery.prepare(
+        auto artistQuery = conn.statement(
+            ArtistsForAlbumQuery,
             QStringLiteral("SELECT artistId FROM Artist2Album WHERE albumId = :albumId"));
-        artistQuery.bindValue(":albumId", album.albumId);
-        if (!artistQuery.exec()) {
-            qWarning() << artistQuery.lastError();
+        artistQuery->bindValue(":albumId", album.albumId);
+        if (!artistQuery->exec()) {
+            qWarning() << artistQuery->lastError();
         }
-        while (artistQuery.next()) {
-            album.artistId.append(artistQuery.value(0).toString());
+        while (artistQuery->next()) {
+            album.artistId.append(artistQuery->value(0).toString());
         }
     }
 
     return std::move(album);
 }
 
-bool Database::insertAlbum_(QSqlDatabase &db, const GMAlbum &album)
+bool Database::insertAlbums_(DBConnection &conn, const GMAlbumList &albums)
 {
-    DBTransaction transaction(db);
+    DBTransaction transaction(conn.db());
 
-    QSqlQuery query(db);
-    query.prepare(
+    auto query = conn.statement(
+        InsertAlbumQuery,
         QStringLiteral("INSERT OR REPLACE INTO Album (id, name, artUrl, descr, year) VALUES (:id, "
                        ":name, :artUrl, :descr, :year)"));
-    query.bindValue(":id", album.albumId);
-    query.bindValue(":name", album.name);
-    query.bindValue(":artUrl", album.albumArtRef);
-    query.bindValue(":descr", album.description);
-    query.bindValue(":year", album.year);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-        return false;
-    }
-    query.finish();
+    auto artistQuery = conn.statement(
+        InsertAlbumArtistQuery, QStringLiteral("INSERT OR REPLACE INTO Artist2Album (artistId, "
+                                               "albumId) VALUES (:artistId, :albumId)"));
+
+    auto searchQuery = conn.statement(
+        UpdateAlbumSearchQuery,
+        QStringLiteral("UPDATE TrackSearch SET album = :name WHERE rowid IN "
+                       "(SELECT rowid FROM Track WHERE albumId = :albumId)"));
+    auto viewQuery = conn.statement(
+        UpdateAlbumViewQuery,
+        QStringLiteral("UPDATE TrackView SET albumName = COALESCE(:name, ''), albumYear = :year, "
+                       "albumArtUrl = :artUrl WHERE albumId = :albumId"));
+
+    for (const auto &album : albums) {
+        query->bindValue(":id", album.albumId);
+        query->bindValue(":name", album.name);
+        query->bindValue(":artUrl", album.albumArtRef);
+        query->bindValue(":descr", album.description);
+        query->bindValue(":year", album.year);
+        if (!query->exec()) {
+            qWarning() << query->lastError();
+            return false;
+        }
 
-    for (int i = 0; i < album.artistId.size(); ++i) {
-        query.prepare(QStringLiteral("INSERT OR REPLACE INTO Artist2Album (artistId, albumId) "
-                                     "VALUES (:artistId, :albumId)"));
-        query.bindValue(":artistId", album.artistId[i]);
-        query.bindValue(":albumId", album.albumId);
-        if (!query.exec()) {
-            qWarning() << query.lastError();
+        searchQuery->bindValue(":name", album.name);
+        searchQuery->bindValue(":albumId", album.albumId);
+        if (!searchQuery->exec()) {
+            qWarning() << searchQuery->lastError();
+            return false;
+        }
+
+        viewQuery->bindValue(":name", album.name);
+        viewQuery->bindValue(":year", album.year);
+        viewQuery->bindValue(":artUrl", album.albumArtRef);
+        viewQuery->bindValue(":albumId", album.albumId);
+        if (!viewQuery->exec()) {
+            qWarning() << viewQuery->lastError();
+            return false;
+        }
+
+        for (int i = 0; i < album.artistId.size(); ++i) {
+            artistQuery->bindValue(":artistId", album.artistId[i]);
+            artistQuery->bindValue(":albumId", album.albumId);
+            if (!artistQuery->exec()) {
+                qWarning() << artistQuery->lastError();
+            }
         }
-        query.finish();
     }
 
     transaction.commit();
@@ -471,74 +1070,194 @@ bool Database::insertAlbum_(QSqlDatabase &db, const GMAlbum &album)
 
 using namespace std::placeholders;
 
-static std::mutex db_mutex_;
-
 bool Database::createTables()
 {
-    return perform(db_mutex_, Database::createSchema_);
+    return performWrite(Database::createSchema_);
+}
+
+// Only covers the statements the calling thread has prepared for this database so far.
+Opt<QHash<QString, QStringList>> Database::queryPlans()
+{
+    return perform(Database::query_plans);
 }
 
 std::optional<GMTrackList> Database::tracks()
 {
-    return perform(db_mutex_, Database::tracks_);
+    return perform(Database::tracks_);
+}
+
+Opt<GMTrackList> Database::tracksPage(const QString &afterId, int limit)
+{
+    return perform(std::bind(Database::tracks_page, _1, afterId, limit));
+}
+
+// Walks the Track table page by page, so at most pageSize tracks are held in memory and no read
+// statement stays open while the visitor runs.
+bool Database::forEachTrack(const TrackVisitor &visitor, int pageSize)
+{
+    QString afterId;
+    while (true) {
+        auto page = tracksPage(afterId, pageSize);
+        if (!page) {
+            return false;
+        }
+        for (const auto &track : *page) {
+            if (!visitor(track)) {
+                return true;
+            }
+        }
+        if (page->size() < pageSize) {
+            return true;
+        }
+        afterId = page->last().id;
+    }
 }
 
 Opt<GMTrackList> Database::tracksForAlbum(const QString &albumId)
 {
-    return perform(db_mutex_, std::bind(Database::tracks_for_album, _1, albumId));
+    return perform(std::bind(Database::tracks_for_album, _1, albumId));
 }
 
 Opt<GMTrackList> Database::tracksForArtist(const QString &artistId)
 {
-    return perform(db_mutex_, std::bind(Database::tracks_for_artist, _1, artistId));
+    return perform(std::bind(Database::tracks_for_artist, _1, artistId));
+}
+
+// Collects the rows visited by visit, which runs one of the visiting TrackView readers.
+template <class Visit> static Opt<GMTrackViewList> collectTrackViews(Visit &&visit)
+{
+    GMTrackViewList rows;
+    if (!visit([&rows](const GMTrackView &row) {
+            rows.append(row);
+            return true;
+        })) {
+        return std::nullopt;
+    }
+    return std::move(rows);
+}
+
+bool Database::trackViews(const TrackViewVisitor &visitor)
+{
+    return perform(std::bind(Database::track_views, _1, visitor));
+}
+
+Opt<GMTrackViewList> Database::trackViews()
+{
+    return collectTrackViews([this](const TrackViewVisitor &visitor) {
+        return trackViews(visitor);
+    });
+}
+
+bool Database::trackViewsPage(const Opt<TrackViewCursor> &after, int limit,
+                              const TrackViewVisitor &visitor)
+{
+    return perform(std::bind(Database::track_views_page, _1, after, limit, visitor));
+}
+
+Opt<GMTrackViewList> Database::trackViewsPage(const Opt<TrackViewCursor> &after, int limit)
+{
+    return collectTrackViews([this, &after, limit](const TrackViewVisitor &visitor) {
+        return trackViewsPage(after, limit, visitor);
+    });
+}
+
+bool Database::trackViewsForAlbum(const QString &albumId, const TrackViewVisitor &visitor)
+{
+    return perform(std::bind(Database::track_views_for_album, _1, albumId, visitor));
+}
+
+Opt<GMTrackViewList> Database::trackViewsForAlbum(const QString &albumId)
+{
+    return collectTrackViews([this, &albumId](const TrackViewVisitor &visitor) {
+        return trackViewsForAlbum(albumId, visitor);
+    });
+}
+
+bool Database::trackViewsForArtist(const QString &artistId, const TrackViewVisitor &visitor)
+{
+    return perform(std::bind(Database::track_views_for_artist, _1, artistId, visitor));
+}
+
+Opt<GMTrackViewList> Database::trackViewsForArtist(const QString &artistId)
+{
+    return collectTrackViews([this, &artistId](const TrackViewVisitor &visitor) {
+        return trackViewsForArtist(artistId, visitor);
+    });
+}
+
+bool Database::search(const QString &text, int limit, const TrackViewVisitor &visitor)
+{
+    return perform(std::bind(Database::search_, _1, text, limit, visitor));
+}
+
+Opt<GMTrackViewList> Database::search(const QString &text, int limit)
+{
+    return collectTrackViews([this, &text, limit](const TrackViewVisitor &visitor) {
+        return search(text, limit, visitor);
+    });
 }
 
 std::optional<GMTrack> Database::track(const QString &id)
 {
-    return perform(db_mutex_, std::bind(Database::track_, _1, id));
+    return perform(std::bind(Database::track_, _1, id));
 }
 
 bool Database::insertTrack(const GMTrack &track)
 {
-    return perform(db_mutex_, std::bind(Database::insertTrack_, _1, track));
+    return performWrite(std::bind(Database::insertTracks_, _1, GMTrackList{track}));
+}
+
+bool Database::insertTracks(const GMTrackList &tracks, int batchSize)
+{
+    return performBatchedWrite(tracks, batchSize, Database::insertTracks_);
 }
 
 bool Database::removeTrack(const QString &id)
 {
-    return perform(db_mutex_, std::bind(Database::removeTrack_, _1, id));
+    return performWrite(std::bind(Database::removeTrack_, _1, id));
 }
 
 std::optional<GMArtistList> Database::artists()
 {
-    return perform(db_mutex_, Database::artists_);
+    return perform(Database::artists_);
 }
 
 std::optional<GMArtist> Database::artist(const QString &id)
 {
-    return perform(db_mutex_, std::bind(Database::artist_, _1, id));
+    return perform(std::bind(Database::artist_, _1, id));
 }
 
 bool Database::insertArtist(const GMArtist &artist)
 {
-    return perform(db_mutex_, std::bind(Database::insertArtist_, _1, artist));
+    return performWrite(std::bind(Database::insertArtists_, _1, GMArtistList{artist}));
+}
+
+bool Database::insertArtists(const GMArtistList &artists, int batchSize)
+{
+    return performBatchedWrite(artists, batchSize, Database::insertArtists_);
 }
 
 std::optional<GMAlbumList> Database::albums()
 {
-    return perform(db_mutex_, Database::albums_);
+    return perform(Database::albums_);
 }
 
 std::optional<GMAlbumList> Database::albumsForArtist(const QString &artistId)
 {
-    return perform(db_mutex_, std::bind(Database::albums_for_artist, _1, artistId));
+    return perform(std::bind(Database::albums_for_artist, _1, artistId));
 }
 
 std::optional<GMAlbum> Database::album(const QString &id)
 {
-    return perform(db_mutex_, std::bind(Database::album_, _1, id));
+    return perform(std::bind(Database::album_, _1, id));
 }
 
 bool Database::insertAlbum(const GMAlbum &album)
 {
-    return perform(db_mutex_, std::bind(Database::insertAlbum_, _1, album));
+    return performWrite(std::bind(Database::insertAlbums_, _1, GMAlbumList{album}));
+}
+
+bool Database::insertAlbums(const GMAlbumList &albums, int batchSize)
+{
+    return performBatchedWrite(albums, batchSize, Database::insertAlbums_);
 }
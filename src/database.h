@@ -1,6 +1,7 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+#include <QHash>
 #include <QObject>
 #include <QSqlDatabase>
 #include <QSqlError>
@@ -9,6 +10,7 @@
 #include <future>
 #include <type_traits>
 
+#include "connectionmanager.h"
 #include "model.h"
 #include "proxyresult.h"
 
@@ -40,59 +42,136 @@ private:
 
 template <class T> using Opt = std::optional<T>;
 
+// Position of a row in the display order of Database::trackViewsPage().
+struct TrackViewCursor {
+    QString artistName;
+    QString albumName;
+    int trackNumber;
+    QString trackId;
+};
+
 class Database : public QObject
 {
     Q_OBJECT
 
 public:
+    // Number of rows the bulk insert methods commit per transaction.
+    static constexpr int DefaultBatchSize = 500;
+    // Number of rows forEachTrack() materialises at a time.
+    static constexpr int DefaultPageSize = 1000;
+
+    // Receives tracks one at a time; returning false stops the iteration.
+    using TrackVisitor = std::function<bool(const GMTrack &)>;
+    // Receives display rows one at a time while the query is stepped; returning false stops it.
+    using TrackViewVisitor = std::function<bool(const GMTrackView &)>;
+
     Database(QObject *parent = nullptr);
     ~Database();
 
-    bool openConnection(const QString &path, QString connName = QString());
+    bool openConnection(const QString &path);
 
     Opt<GMTrackList> tracks();
+    Opt<GMTrackList> tracksPage(const QString &afterId, int limit);
+    bool forEachTrack(const TrackVisitor &visitor, int pageSize = DefaultPageSize);
     Opt<GMTrackList> tracksForAlbum(const QString &albumId);
     Opt<GMTrackList> tracksForArtist(const QString &artistId);
     Opt<GMTrack> track(const QString &id);
+    // The TrackView readers return rows in display order, either as a list or one at a time.
+    Opt<GMTrackViewList> trackViews();
+    bool trackViews(const TrackViewVisitor &visitor);
+    Opt<GMTrackViewList> trackViewsPage(const Opt<TrackViewCursor> &after, int limit);
+    bool trackViewsPage(const Opt<TrackViewCursor> &after, int limit,
+                        const TrackViewVisitor &visitor);
+    Opt<GMTrackViewList> trackViewsForAlbum(const QString &albumId);
+    bool trackViewsForAlbum(const QString &albumId, const TrackViewVisitor &visitor);
+    Opt<GMTrackViewList> trackViewsForArtist(const QString &artistId);
+    bool trackViewsForArtist(const QString &artistId, const TrackViewVisitor &visitor);
+    Opt<GMTrackViewList> search(const QString &text, int limit);
+    bool search(const QString &text, int limit, const TrackViewVisitor &visitor);
     bool insertTrack(const GMTrack &track);
+    bool insertTracks(const GMTrackList &tracks, int batchSize = DefaultBatchSize);
     bool removeTrack(const QString &id);
     Opt<GMArtistList> artists();
     Opt<GMArtist> artist(const QString &id);
     bool insertArtist(const GMArtist &artist);
+    bool insertArtists(const GMArtistList &artists, int batchSize = DefaultBatchSize);
     bool insertAlbum(const GMAlbum &album);
+    bool insertAlbums(const GMAlbumList &albums, int batchSize = DefaultBatchSize);
     Opt<GMAlbumList> albums();
     Opt<GMAlbumList> albumsForArtist(const QString &artistId);
     Opt<GMAlbum> album(const QString &id);
 
     bool createTables();
+    Opt<QHash<QString, QStringList>> queryPlans();
 
 private:
-    static bool createSchema_(QSqlDatabase &db);
-    static Opt<GMTrackList> tracks_(QSqlDatabase &db);
-    static Opt<GMTrackList> tracks_for_album(QSqlDatabase &db, const QString &albumId);
-    static Opt<GMTrackList> tracks_for_artist(QSqlDatabase &db, const QString &artistId);
-    static Opt<GMTrack> track_(QSqlDatabase &db, const QString &id);
-    static bool insertTrack_(QSqlDatabase &db, const GMTrack &track);
-    static bool removeTrack_(QSqlDatabase &db, const QString &id);
-
-    static Opt<GMArtistList> artists_(QSqlDatabase &db);
-    static Opt<GMArtist> artist_(QSqlDatabase &db, const QString &id);
-    static bool insertArtist_(QSqlDatabase &db, const GMArtist &artist);
-
-    static Opt<GMAlbumList> albums_(QSqlDatabase &db);
-    static Opt<GMAlbumList> albums_for_artist(QSqlDatabase &db, const QString &artistId);
-    static Opt<GMAlbum> album_(QSqlDatabase &db, const QString &id);
-    static bool insertAlbum_(QSqlDatabase &db, const GMAlbum &album);
-
-    static Opt<GMTrackList> extractTracks(QSqlDatabase &db, QSqlQuery &query);
-
-    template <class Action> auto perform(std::mutex &mutex, Action &&action)
+    static bool createSchema_(DBConnection &conn);
+    static Opt<QHash<QString, QStringList>> query_plans(DBConnection &conn);
+    static Opt<GMTrackList> tracks_(DBConnection &conn);
+    static Opt<GMTrackList> tracks_page(DBConnection &conn, const QString &afterId, int limit);
+    static Opt<GMTrackList> tracks_for_album(DBConnection &conn, const QString &albumId);
+    static Opt<GMTrackList> tracks_for_artist(DBConnection &conn, const QString &artistId);
+    static Opt<GMTrack> track_(DBConnection &conn, const QString &id);
+    static bool track_views(DBConnection &conn, const TrackViewVisitor &visitor);
+    static bool track_views_page(DBConnection &conn, const Opt<TrackViewCursor> &after, int limit,
+                                 const TrackViewVisitor &visitor);
+    static bool track_views_for_album(DBConnection &conn, const QString &albumId,
+                                      const TrackViewVisitor &visitor);
+    static bool track_views_for_artist(DBConnection &conn, const QString &artistId,
+                                       const TrackViewVisitor &visitor);
+    static bool search_(DBConnection &conn, const QString &text, int limit,
+                        const TrackViewVisitor &visitor);
+    static bool insertTracks_(DBConnection &conn, const GMTrackList &tracks);
+    static bool removeTrack_(DBConnection &conn, const QString &id);
+
+    static Opt<GMArtistList> artists_(DBConnection &conn);
+    static Opt<GMArtist> artist_(DBConnection &conn, const QString &id);
+    static bool insertArtists_(DBConnection &conn, const GMArtistList &artists);
+
+    static Opt<GMAlbumList> albums_(DBConnection &conn);
+    static Opt<GMAlbumList> albums_for_artist(DBConnection &conn, const QString &artistId);
+    static Opt<GMAlbum> album_(DBConnection &conn, const QString &id);
+    static bool insertAlbums_(DBConnection &conn, const GMAlbumList &albums);
+
+    static Opt<GMTrackList> extractTracks(QSqlQuery &query, QSqlQuery &artistQuery);
+    static bool visitTrackViews(QSqlQuery &query, const TrackViewVisitor &visitor);
+    static Opt<GMAlbumList> extractAlbums(QSqlQuery &query, QSqlQuery &artistQuery);
+
+    static void assertNotGuiThread();
+
+    // Runs action on the calling thread's own connection; readers do not block each other.
+    template <class Action> auto perform(Action &&action)
+    {
+        assertNotGuiThread();
+        DBConnection conn = ConnectionManager::instance().connection(path_);
+        return action(conn);
+    }
+
+    // Same as perform(), but serialized with every other writer to the same database file.
+    template <class Action> auto performWrite(Action &&action)
+    {
+        std::lock_guard<std::mutex> guard(ConnectionManager::instance().writeMutex(path_));
+        return perform(std::forward<Action>(action));
+    }
+
+    // Splits items into batches of batchSize and writes every batch in its own transaction.
+    template <class List, class Action>
+    bool performBatchedWrite(const List &items, int batchSize, Action &&action)
     {
-        std::lock_guard<std::mutex> guard(mutex);
-        return action(db_);
+        if (batchSize <= 0) {
+            batchSize = items.size();
+        }
+        for (int i = 0; i < items.size(); i += batchSize) {
+            List batch = items.mid(i, batchSize);
+            if (!performWrite(
+                    [&action, &batch](DBConnection &conn) { return action(conn, batch); })) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    QSqlDatabase db_;
+    QString path_;
 };
 
 #endif // DATABASE_H
@@ -13,6 +13,8 @@
 #include <QUrl>
 #include <memory>
 
+#include "asyncdatabase.h"
+#include "connectionmanager.h"
 #include "proxyresult.h"
 #include "utils.h"
 
@@ -35,54 +37,116 @@ ImageStorage::ImageStorage(QObject *parent)
     cacheDir.cd("images");
     imageCacheDirPath_ = cacheDir.absolutePath();
 
-    db_ = QSqlDatabase::addDatabase("QSQLITE", "IMAGE_STORAGE");
-    db_.setDatabaseName(QDir(Utils::dataPath()).absoluteFilePath("image_storage.sqlite"));
-    if (!db_.open()) {
-        qWarning() << "could not open database" << db_.lastError();
-        return;
+    db_     = new AsyncDatabase(this);
+    dbPath_ = QDir(Utils::dataPath()).absoluteFilePath("image_storage.sqlite");
+    loadCacheEntries();
+}
+
+ImageStorage::~ImageStorage()
+{
+}
+
+// The statements below run on the database thread, on its connection to the image cache file
+// rather than through Database, whose schema is the library's. The table is created on first use.
+static Opt<QHash<QString, QString>> readCacheEntries(const QString &path)
+{
+    DBConnection conn = ConnectionManager::instance().connection(path);
+    QSqlQuery query(conn.db());
+    if (!query.exec(
+            QStringLiteral("CREATE TABLE IF NOT EXISTS ImageCacheMetadata(url TEXT "
+                           "PRIMARY KEY, localPath TEXT NOT NULL, timestamp INTEGER NOT NULL)"))) {
+        qWarning() << query.lastError();
+        return std::nullopt;
     }
-    if (!createDatabaseSchema()) {
-        qWarning() << "could not create database schema";
-        return;
+    if (!query.exec(QStringLiteral("SELECT url, localPath FROM ImageCacheMetadata"))) {
+        qWarning() << query.lastError();
+        return std::nullopt;
+    }
+    QHash<QString, QString> entries;
+    while (query.next()) {
+        entries.insert(query.value(0).toString(), query.value(1).toString());
     }
-    initialized_ = true;
+    return std::move(entries);
 }
 
-ImageStorage::~ImageStorage()
+static void writeCacheEntry(const QString &path, const QString &url, const QString &filepath)
 {
+    DBConnection conn = ConnectionManager::instance().connection(path);
+    QSqlQuery query(conn.db());
+    query.prepare(
+        QStringLiteral("INSERT OR REPLACE INTO ImageCacheMetadata(url, localPath, timestamp) "
+                       "VALUES(:url, :localPath, :timestamp)"));
+    query.bindValue(":url", url);
+    query.bindValue(":localPath", filepath);
+    query.bindValue(":timestamp", QDateTime::currentMSecsSinceEpoch());
+    if (!query.exec()) {
+        qWarning() << query.lastError();
+    }
 }
 
-bool ImageStorage::createDatabaseSchema()
+static void deleteCacheEntry(const QString &path, const QString &url)
 {
-    QSqlQuery query(db_);
-    return query.exec(
-        QStringLiteral("CREATE TABLE IF NOT EXISTS ImageCacheMetadata(url TEXT "
-                       "PRIMARY KEY, localPath TEXT NOT NULL, timestamp INTEGER NOT NULL)"));
+    DBConnection conn = ConnectionManager::instance().connection(path);
+    QSqlQuery query(conn.db());
+    query.prepare(QStringLiteral("DELETE FROM ImageCacheMetadata WHERE url = :url"));
+    query.bindValue(":url", url);
+    if (!query.exec()) {
+        qWarning() << query.lastError();
+    }
 }
 
-QByteArray ImageStorage::tryGetImage(const QString &url)
+// The cache entries are kept in memory, so looking an image up does not query the database.
+// Lookups made while they load are answered once they arrive.
+void ImageStorage::loadCacheEntries()
+{
+    QString path = dbPath_;
+    db_->run([path](Database &) { return readCacheEntries(path); },
+             [this](const Opt<QHash<QString, QString>> &entries) {
+                 if (!entries) {
+                     qWarning() << "could not read image cache entries";
+                     pendingLookups_.clear();
+                     return;
+                 }
+                 cachedPaths_ = *entries;
+                 initialized_ = true;
+                 for (const QString &url : qAsConst(pendingLookups_)) {
+                     if (cachedPaths_.contains(url)) {
+                         emit imageUpdated(url);
+                     } else {
+                         scheduleNextDownload(url);
+                     }
+                 }
+                 pendingLookups_.clear();
+             });
+}
+
+QString ImageStorage::cachedImagePath(const QString &url)
 {
     if (!initialized_) {
-        return QByteArray();
+        pendingLookups_.insert(url);
+        return QString();
     }
 
-    QSqlQuery query(db_);
-    query.prepare(QStringLiteral("SELECT localPath FROM ImageCacheMetadata WHERE url = :url"));
-    query.bindValue(":url", url);
-    query.exec();
-    if (query.next()) {
-        QString filePath = query.value(0).toString();
-        QFile imageFile(filePath);
-        if (!imageFile.open(QFile::ReadOnly)) {
-            removeCacheEntry(filePath, url);
-            scheduleNextDownload(url);
-            return QByteArray();
-        }
-        return imageFile.readAll();
+    auto it = cachedPaths_.constFind(url);
+    if (it != cachedPaths_.constEnd()) {
+        return it.value();
+    }
+
+    scheduleNextDownload(url);
+    return QString();
+}
+
+void ImageStorage::discardImage(const QString &url)
+{
+    if (!initialized_) {
+        return;
     }
 
+    auto it = cachedPaths_.constFind(url);
+    if (it != cachedPaths_.constEnd()) {
+        removeCacheEntry(it.value(), url);
+    }
     scheduleNextDownload(url);
-    return QByteArray();
 }
 
 void ImageStorage::scheduleNextDownload(const QString &url)
@@ -131,33 +195,29 @@ void ImageStorage::downloadImage(const QString &url)
         }
         failureCounter_ = 0;
         insertCacheEntry(url, filepath);
-        QTimer::singleShot(1000, this, [this, url] { emit imageUpdated(url); });
+        emit imageUpdated(url);
     });
 }
 
 void ImageStorage::insertCacheEntry(const QString &url, const QString &filepath)
 {
-    QSqlQuery query(db_);
-    query.prepare(
-        QStringLiteral("INSERT OR REPLACE INTO ImageCacheMetadata(url, localPath, timestamp) "
-                       "VALUES(:url, :localPath, :timestamp)"));
-    query.bindValue(":url", url);
-    query.bindValue(":localPath", filepath);
-    query.bindValue(":timestamp", QDateTime::currentMSecsSinceEpoch());
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-    }
+    cachedPaths_.insert(url, filepath);
+    QString path = dbPath_;
+    db_->run([path, url, filepath](Database &) {
+        writeCacheEntry(path, url, filepath);
+        return true;
+    });
 }
 
 void ImageStorage::removeCacheEntry(const QString &path, const QString &url)
 {
+    cachedPaths_.remove(url);
     if (QFile::exists(path)) {
         QFile::remove(path);
     }
-    QSqlQuery query(db_);
-    query.prepare(QStringLiteral("DELETE FROM ImageCacheMetadata WHERE url = :url"));
-    query.bindValue(":url", url);
-    if (!query.exec()) {
-        qWarning() << query.lastError();
-    }
+    QString dbPath = dbPath_;
+    db_->run([dbPath, url](Database &) {
+        deleteCacheEntry(dbPath, url);
+        return true;
+    });
 }
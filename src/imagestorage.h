@@ -1,12 +1,13 @@
 #ifndef IMAGESTORAGE_H
 #define IMAGESTORAGE_H
 
+#include <QHash>
 #include <QObject>
 #include <QSet>
-#include <QSqlDatabase>
 #include <QTimer>
 #include <QVector>
 
+class AsyncDatabase;
 class ProxyResult;
 class QNetworkAccessManager;
 
@@ -19,7 +20,10 @@ public:
     ImageStorage &operator=(const ImageStorage &) = delete;
     ~ImageStorage();
 
-    QByteArray tryGetImage(const QString &url);
+    // Path of the downloaded image at url, or an empty string after scheduling its download.
+    QString cachedImagePath(const QString &url);
+    // Forgets a downloaded image that could not be read and downloads it again.
+    void discardImage(const QString &url);
 
 signals:
     void imageUpdated(const QString &url);
@@ -27,14 +31,20 @@ signals:
 private:
     explicit ImageStorage(QObject *parent = nullptr);
 
-    QSqlDatabase db_;
+    // Runs the ImageCacheMetadata statements on the database thread.
+    AsyncDatabase *db_;
+    QString dbPath_;
     QNetworkAccessManager *manager_;
     QString imageCacheDirPath_;
     QSet<QString> activeDownloads_;
+    // Local path of every downloaded image by url, as stored in ImageCacheMetadata.
+    QHash<QString, QString> cachedPaths_;
+    // Urls asked for before the entries were loaded.
+    QSet<QString> pendingLookups_;
     qint64 failureCounter_;
     bool initialized_;
 
-    bool createDatabaseSchema();
+    void loadCacheEntries();
     void insertCacheEntry(const QString &url, const QString &filepath);
     void removeCacheEntry(const QString &filePath, const QString &url);
     void downloadImage(const QString &url);
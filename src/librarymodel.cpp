@@ -2,117 +2,252 @@
 
 #include <QDebug>
 #include <QPixmap>
-#include <QPixmapCache>
 #include <QTimer>
 
+#include "asyncdatabase.h"
 #include "database.h"
 #include "imagestorage.h"
 #include "model.h"
+#include "thumbnailloader.h"
 
-LibraryModelNode::~LibraryModelNode()
+#define FRAME_MSEC 16
+
+LibraryModel::LibraryModel(QObject *parent)
+    : QAbstractItemModel(parent),
+      releasedNodes_(0),
+      tree_(std::make_shared<const LibraryTree>()),
+      imageStorage_(ImageStorage::instance()),
+      thumbnailLoader_(ThumbnailLoader::instance())
 {
-    qDeleteAll(children);
+    thumbnailTimer_ = new QTimer(this);
+    thumbnailTimer_->setSingleShot(true);
+    thumbnailTimer_->setInterval(FRAME_MSEC);
+    connect(thumbnailTimer_, &QTimer::timeout, this, &LibraryModel::updateThumbnails);
+    db_ = new AsyncDatabase(this);
+    connect(&imageStorage_, &ImageStorage::imageUpdated, this, &LibraryModel::thumbnailChanged);
+    connect(&thumbnailLoader_, &ThumbnailLoader::thumbnailReady, this,
+            &LibraryModel::thumbnailChanged);
 }
 
-void RootLibraryNode::load_children(Database *db)
+LibraryModel::~LibraryModel()
 {
-    if (!children.empty()) {
-        qDeleteAll(children);
-        children.clear();
-    }
-    if (auto artists = db->artists()) {
-        for (int i = 0; i < artists->size(); ++i) {
-            children.push_back(
-                new ArtistLibraryNode(0, i, QVariant::fromValue(artists->at(i)), this));
-        }
-    } else {
-        qWarning() << "RootLibraryNode: failed to read artists from database";
+}
+
+// The whole library is read on the database thread in three queries and compared there with the
+// tree shown, so only the artists and albums that changed are removed and inserted; expanded and
+// selected nodes stay as they are. Album nodes are only created when their artist is expanded.
+void LibraryModel::reloadData()
+{
+    auto from = tree_;
+    db_->run(
+        [from](Database &db) -> Opt<LoadedTree> {
+            auto tree = LibraryTree::load(db);
+            if (!tree) {
+                return std::nullopt;
+            }
+            return LoadedTree{*tree, LibraryTree::diff(*from, *tree)};
+        },
+        [this, from](const Opt<LoadedTree> &loaded) {
+            if (!loaded) {
+                return;
+            }
+            // Another reload was applied meanwhile, or updates left mostly unused nodes behind.
+            if (from != tree_ || releasedNodes_ > nodes_.size() / 2) {
+                resetTree(loaded->tree);
+                return;
+            }
+            applyDiff(*loaded);
+        });
+}
+
+void LibraryModel::resetTree(const LibraryTree &tree)
+{
+    Q_EMIT beginResetModel();
+    tree_ = std::make_shared<const LibraryTree>(tree);
+    nodes_.clear();
+    children_.clear();
+    topLevel_.clear();
+    releasedNodes_ = 0;
+    pendingThumbnails_.clear();
+    nodes_.reserve(tree.artists.size());
+    children_.reserve(tree.artists.size());
+    topLevel_.reserve(tree.artists.size());
+    for (int i = 0; i < tree.artists.size(); ++i) {
+        topLevel_.append(appendNode(-1, i, i, LibraryNode::Artist));
     }
+    Q_EMIT endResetModel();
 }
 
-void ArtistLibraryNode::load_children(Database *db)
+// Removals are applied against the old tree and insertions against the new one, so every node
+// has an item to show at each step.
+void LibraryModel::applyDiff(const LoadedTree &loaded)
 {
-    if (!children.empty()) {
-        qDeleteAll(children);
-        children.clear();
+    const auto &diff = loaded.diff;
+
+    for (auto it = diff.albums.constBegin(); it != diff.albums.constEnd(); ++it) {
+        int artist = topLevel_[it.key()];
+        if (nodes_[artist].childrenLoaded) {
+            for (const auto &range : it->removed) {
+                removeNodes(createIndex(it.key(), 0, quintptr(artist)), artist, range);
+            }
+        }
+    }
+    for (const auto &range : diff.artists.removed) {
+        removeNodes(QModelIndex(), -1, range);
     }
-    auto artist = data.value<GMArtist>();
 
-    if (auto albums = db->albumsForArtist(artist.artistId)) {
-        for (int i = 0; i < albums->size(); ++i) {
-            children.push_back(
-                new AlbumLibraryNode(1, i, QVariant::fromValue(albums->at(i)), this));
+    tree_ = std::make_shared<const LibraryTree>(loaded.tree);
+    for (auto &node : nodes_) {
+        if (node.item >= 0) {
+            node.item = node.kind == LibraryNode::Artist ? diff.artistPositions[node.item]
+                                                         : diff.albumPositions[node.item];
         }
-    } else {
-        qWarning() << "ArtistLibraryNode: failed to load albums for artist with id: "
-                   << artist.artistId << ", name: " << artist.name;
+    }
+
+    for (const auto &range : diff.artists.inserted) {
+        insertNodes(QModelIndex(), -1, range);
+    }
+    for (auto it = diff.albums.constBegin(); it != diff.albums.constEnd(); ++it) {
+        int row    = diff.artistPositions[it.key()];
+        int artist = topLevel_[row];
+        if (!nodes_[artist].childrenLoaded) {
+            continue;
+        }
+        QModelIndex parent = createIndex(row, 0, quintptr(artist));
+        for (const auto &range : it->inserted) {
+            insertNodes(parent, artist, range);
+        }
+        for (const auto &range : it->changed) {
+            emit dataChanged(index(range.first, 0, parent),
+                             index(range.first + range.count - 1, 0, parent));
+        }
+    }
+    for (const auto &range : diff.artists.changed) {
+        emit dataChanged(index(range.first, 0), index(range.first + range.count - 1, 0));
     }
 }
 
-TracksLoader ArtistLibraryNode::tracksLoader() const
+int LibraryModel::appendNode(int parent, int row, int item, LibraryNode::Kind kind)
 {
-    auto artistId = data.value<GMArtist>().artistId;
-    return [artistId](Database &db) { return db.tracksForArtist(artistId); };
+    nodes_.append({parent, row, item, kind, kind == LibraryNode::Album});
+    children_.append(QVector<int>());
+    return nodes_.size() - 1;
 }
 
-QVariant ArtistLibraryNode::presentation_value() const
+// Creates the nodes for rows of parent, which already exist in tree_.
+void LibraryModel::insertNodes(const QModelIndex &parent, int parentNode,
+                               const RowDiff::Range &range)
 {
-    return data.value<GMArtist>().name;
+    beginInsertRows(parent, range.first, range.first + range.count - 1);
+    QVector<int> inserted;
+    inserted.reserve(range.count);
+    for (int row = range.first; row < range.first + range.count; ++row) {
+        if (parentNode < 0) {
+            inserted.append(appendNode(-1, row, row, LibraryNode::Artist));
+        } else {
+            int album = tree_->artistAlbums[nodes_[parentNode].item][row];
+            inserted.append(appendNode(parentNode, row, album, LibraryNode::Album));
+        }
+    }
+
+    QVector<int> &rows = parentNode < 0 ? topLevel_ : children_[parentNode];
+    rows.insert(range.first, range.count, -1);
+    std::copy(inserted.begin(), inserted.end(), rows.begin() + range.first);
+    for (int i = range.first + range.count; i < rows.size(); ++i) {
+        nodes_[rows[i]].row = i;
+    }
+    endInsertRows();
 }
 
-QString ArtistLibraryNode::imageUrl() const
+void LibraryModel::removeNodes(const QModelIndex &parent, int parentNode,
+                               const RowDiff::Range &range)
 {
-    return data.value<GMArtist>().artistArtRef;
+    beginRemoveRows(parent, range.first, range.first + range.count - 1);
+    QVector<int> &rows = parentNode < 0 ? topLevel_ : children_[parentNode];
+    for (int i = range.first; i < range.first + range.count; ++i) {
+        releaseNode(rows[i]);
+    }
+    rows.remove(range.first, range.count);
+    for (int i = range.first; i < rows.size(); ++i) {
+        nodes_[rows[i]].row = i;
+    }
+    endRemoveRows();
 }
 
-TracksLoader AlbumLibraryNode::tracksLoader() const
+void LibraryModel::releaseNode(int node)
 {
-    auto albumId = data.value<GMAlbum>().albumId;
-    return [albumId](Database &db) { return db.tracksForAlbum(albumId); };
+    for (int child : children_[node]) {
+        releaseNode(child);
+    }
+    children_[node]   = QVector<int>();
+    nodes_[node].item  = -1;
+    ++releasedNodes_;
 }
 
-QVariant AlbumLibraryNode::presentation_value() const
+// The node of a model index, nullptr for the invisible root.
+const LibraryNode *LibraryModel::nodeFor(const QModelIndex &index) const
 {
-    return data.value<GMAlbum>().name;
+    return index.isValid() ? &nodes_[int(index.internalId())] : nullptr;
 }
 
-QString AlbumLibraryNode::imageUrl() const
+const LibraryItem &LibraryModel::itemFor(const LibraryNode &node) const
 {
-    return data.value<GMAlbum>().albumArtRef;
+    return node.kind == LibraryNode::Artist ? tree_->artists[node.item] : tree_->albums[node.item];
 }
 
-LibraryModel::LibraryModel(QObject *parent)
-    : QAbstractItemModel(parent), imageStorage_(ImageStorage::instance())
+TracksLoader LibraryModel::tracksLoader(const QModelIndex &index) const
 {
-    deferredUpdateTimer_ = new QTimer(this);
-    deferredUpdateTimer_->setSingleShot(true);
-    deferredUpdateTimer_->setInterval(3000);
-    connect(deferredUpdateTimer_, &QTimer::timeout, this, &LibraryModel::reloadDecoationData);
-    _root = new RootLibraryNode(-1, 0, QVariant(), nullptr);
-    connect(&imageStorage_, SIGNAL(imageUpdated(QString)), deferredUpdateTimer_, SLOT(start()));
+    const LibraryNode *node = nodeFor(index);
+    if (!node) {
+        return [](Database &db, const Database::TrackViewVisitor &visitor) {
+            return db.trackViews(visitor);
+        };
+    }
+    QString id = itemFor(*node).id;
+    if (node->kind == LibraryNode::Artist) {
+        return [id](Database &db, const Database::TrackViewVisitor &visitor) {
+            return db.trackViewsForArtist(id, visitor);
+        };
+    }
+    return [id](Database &db, const Database::TrackViewVisitor &visitor) {
+        return db.trackViewsForAlbum(id, visitor);
+    };
 }
 
-LibraryModel::~LibraryModel()
+bool LibraryModel::hasChildren(const QModelIndex &parent) const
 {
-    delete _root;
+    const LibraryNode *node = nodeFor(parent);
+    if (!node) {
+        return !topLevel_.isEmpty();
+    }
+    if (node->kind == LibraryNode::Album) {
+        return false;
+    }
+    if (!node->childrenLoaded) {
+        return !tree_->artistAlbums[node->item].isEmpty();
+    }
+    return !children_[int(parent.internalId())].isEmpty();
 }
 
-void LibraryModel::reloadData()
+bool LibraryModel::canFetchMore(const QModelIndex &parent) const
 {
-    Q_EMIT beginResetModel();
-    _root->clear_children();
-    build_tree(_root, &db_);
-    Q_EMIT endResetModel();
+    const LibraryNode *node = nodeFor(parent);
+    return node && node->kind == LibraryNode::Artist && !node->childrenLoaded;
 }
 
-void LibraryModel::build_tree(LibraryModelNode *root, Database *db)
+// Creates the album nodes of an artist from the loaded library.
+void LibraryModel::fetchMore(const QModelIndex &parent)
 {
-    if (root->is_leaf) {
+    if (!canFetchMore(parent)) {
         return;
     }
-    root->load_children(db);
-    for (int i = 0; i < root->children.size(); ++i) {
-        build_tree(root->children[i], db);
+
+    int artist = int(parent.internalId());
+    int albums = tree_->artistAlbums[nodes_[artist].item].size();
+
+    nodes_[artist].childrenLoaded = true;
+    if (albums > 0) {
+        insertNodes(parent, artist, {0, albums});
     }
 }
 
@@ -122,40 +257,25 @@ QModelIndex LibraryModel::index(int row, int column, const QModelIndex &parent)
         return QModelIndex();
     }
 
-    LibraryModelNode *node;
-    if (parent.isValid()) {
-        node = static_cast<LibraryModelNode *>(parent.internalPointer());
-    } else {
-        node = _root;
-    }
-    LibraryModelNode *child = node->childAt(row);
-    if (child) {
-        return createIndex(row, column, child);
-    }
-    return QModelIndex();
+    const auto &rows = parent.isValid() ? children_[int(parent.internalId())] : topLevel_;
+    return createIndex(row, column, quintptr(rows[row]));
 }
 
 QModelIndex LibraryModel::parent(const QModelIndex &index) const
 {
-    if (!index.isValid()) {
+    const LibraryNode *node = nodeFor(index);
+    if (!node || node->parent < 0) {
         return QModelIndex();
     }
-    auto node = static_cast<LibraryModelNode *>(index.internalPointer());
-    if (node->level == 0 || !node->parent) {
-        return QModelIndex();
-    }
-    return createIndex(node->parent->index, 0, node->parent);
+    return createIndex(nodes_[node->parent].row, 0, quintptr(node->parent));
 }
 
 int LibraryModel::rowCount(const QModelIndex &parent) const
 {
-    LibraryModelNode *node;
     if (!parent.isValid()) {
-        node = _root;
-    } else {
-        node = static_cast<LibraryModelNode *>(parent.internalPointer());
+        return topLevel_.size();
     }
-    return node->children.size();
+    return parent.column() == 0 ? children_[int(parent.internalId())].size() : 0;
 }
 
 int LibraryModel::columnCount(const QModelIndex & /*parent*/) const
@@ -168,25 +288,24 @@ QVariant LibraryModel::data(const QModelIndex &index, int role) const
     if (!index.isValid()) {
         return QVariant();
     }
-    auto node = static_cast<LibraryModelNode *>(index.internalPointer());
+    const LibraryItem &item = itemFor(*nodeFor(index));
     if (role == Qt::DisplayRole) {
-        return node->presentation_value();
+        return item.name;
     } else if (role == Qt::DecorationRole) {
-        QString imageUrl = node->imageUrl();
-        if (!imageUrl.isEmpty()) {
-            QPixmap *cachedImg = QPixmapCache::find(imageUrl);
-            if (cachedImg)
-                return *cachedImg;
-            QByteArray imageData = imageStorage_.tryGetImage(imageUrl);
-            if (!imageData.isEmpty()) {
-                QPixmap img;
-                if (img.loadFromData(imageData)) {
-                    QPixmap scaledImg = img.scaled(24, 24, Qt::KeepAspectRatio);
-                    QPixmapCache::insert(imageUrl, scaledImg);
-                    return scaledImg;
-                }
+        if (item.artUrl.isEmpty()) {
+            return QVariant();
+        }
+        bool ready;
+        QPixmap thumbnail = thumbnailLoader_.thumbnail(item.artUrl, &ready);
+        if (!ready) {
+            QPersistentModelIndex pending(index);
+            if (!pendingThumbnails_.contains(item.artUrl, pending)) {
+                pendingThumbnails_.insert(item.artUrl, pending);
             }
         }
+        if (!thumbnail.isNull()) {
+            return thumbnail;
+        }
     } else if (role == Qt::SizeHintRole) {
         return QSize(INT_MAX, 30);
     }
@@ -214,14 +333,28 @@ QVariant LibraryModel::headerData(int section, Qt::Orientation orientation, int
 
 void LibraryModel::setDatabasePath(const QString &dbPath)
 {
-    if (!db_.openConnection(dbPath)) {
-        qWarning() << "could not open database at" << dbPath;
-        return;
+    db_->setDatabasePath(dbPath);
+}
+
+// Artwork is downloaded and decoded one url at a time, so the urls that changed are collected and
+// only the indexes that were shown with a placeholder for them are repainted, once per frame.
+void LibraryModel::thumbnailChanged(const QString &url)
+{
+    changedThumbnails_.insert(url);
+    if (!thumbnailTimer_->isActive()) {
+        thumbnailTimer_->start();
     }
 }
 
-void LibraryModel::reloadDecoationData()
+void LibraryModel::updateThumbnails()
 {
-    emit dataChanged(index(0, 0), index(_root->children.size() - 1, 0),
-                     QVector<int>{Qt::DecorationRole});
+    for (const QString &url : qAsConst(changedThumbnails_)) {
+        for (const QPersistentModelIndex &index : pendingThumbnails_.values(url)) {
+            if (index.isValid()) {
+                emit dataChanged(index, index, QVector<int>{Qt::DecorationRole});
+            }
+        }
+        pendingThumbnails_.remove(url);
+    }
+    changedThumbnails_.clear();
 }
@@ -2,88 +2,19 @@
 #define LIBRARYMODEL_H
 
 #include <QAbstractItemModel>
+#include <QMultiHash>
+#include <QPersistentModelIndex>
 #include <QSet>
+#include <memory>
 
 #include "database.h"
+#include "librarytree.h"
 
-using TracksLoader = std::function<Opt<GMTrackList>(Database &)>;
-
-struct LibraryModelNode {
-    LibraryModelNode(int level, int index, const QVariant &data, LibraryModelNode *parent,
-                     bool is_leaf)
-        : level(level), index(index), data(data), is_leaf(is_leaf), parent(parent)
-    {
-    }
-    virtual ~LibraryModelNode();
-
-    void clear_children()
-    {
-        qDeleteAll(children);
-        children.clear();
-    }
-
-    virtual void load_children(Database * /*db*/)
-    {
-    }
-
-    virtual TracksLoader tracksLoader() const
-    {
-        return [](Database &db) { return db.tracks(); };
-    }
-
-    virtual QVariant presentation_value() const = 0;
-    virtual QString imageUrl() const
-    {
-        return QString();
-    }
-
-    LibraryModelNode *childAt(int index)
-    {
-        return children.value(index, nullptr);
-    }
-
-    int level;
-    int index;
-    QVariant data;
-    bool is_leaf;
-    QList<LibraryModelNode *> children;
-    LibraryModelNode *parent;
-};
-
-struct RootLibraryNode : public LibraryModelNode {
-    RootLibraryNode(int level, int index, const QVariant &data, LibraryModelNode *parent)
-        : LibraryModelNode(level, index, data, parent, false)
-    {
-    }
-    QVariant presentation_value() const override
-    {
-        return QVariant();
-    }
-    void load_children(Database *db) override;
-};
-
-struct ArtistLibraryNode : public LibraryModelNode {
-    ArtistLibraryNode(int level, int index, const QVariant &data, LibraryModelNode *parent)
-        : LibraryModelNode(level, index, data, parent, false)
-    {
-    }
-    QVariant presentation_value() const override;
-    QString imageUrl() const override;
-    TracksLoader tracksLoader() const override;
-    void load_children(Database *db) override;
-};
-
-struct AlbumLibraryNode : public LibraryModelNode {
-    AlbumLibraryNode(int level, int index, const QVariant &data, LibraryModelNode *parent)
-        : LibraryModelNode(level, index, data, parent, true)
-    {
-    }
-    QVariant presentation_value() const override;
-    QString imageUrl() const override;
-    TracksLoader tracksLoader() const override;
-};
+using TracksLoader = std::function<bool(Database &, const Database::TrackViewVisitor &)>;
 
+class AsyncDatabase;
 class ImageStorage;
+class ThumbnailLoader;
 class QTimer;
 
 class LibraryModel : public QAbstractItemModel
@@ -102,22 +33,53 @@ public:
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     QVariant headerData(int section, Qt::Orientation orientation,
                         int role = Qt::DisplayRole) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
     void reloadData();
+    TracksLoader tracksLoader(const QModelIndex &index) const;
 
 public slots:
     void setDatabasePath(const QString &path);
 
 private slots:
-    void reloadDecoationData();
+    void thumbnailChanged(const QString &url);
+    void updateThumbnails();
 
 private:
-    void build_tree(LibraryModelNode *root, Database *db);
-    LibraryModelNode *_root;
-    Database db_;
+    // A reloaded tree with its changes from the tree the reload started from.
+    struct LoadedTree {
+        LibraryTree tree;
+        LibraryTreeDiff diff;
+    };
+
+    const LibraryNode *nodeFor(const QModelIndex &index) const;
+    const LibraryItem &itemFor(const LibraryNode &node) const;
+
+    void resetTree(const LibraryTree &tree);
+    void applyDiff(const LoadedTree &loaded);
+    int appendNode(int parent, int row, int item, LibraryNode::Kind kind);
+    void insertNodes(const QModelIndex &parent, int parentNode, const RowDiff::Range &range);
+    void removeNodes(const QModelIndex &parent, int parentNode, const RowDiff::Range &range);
+    void releaseNode(int node);
+
+    // A node keeps its position for as long as it exists, so model indexes carry it as their
+    // internal id. Removed nodes stay behind unused until the next reset.
+    LibraryNodeList nodes_;
+    // Child positions of every node in row order, and the top-level nodes, the artists.
+    QVector<QVector<int>> children_;
+    QVector<int> topLevel_;
+    int releasedNodes_;
+    std::shared_ptr<const LibraryTree> tree_;
+    AsyncDatabase *db_;
     ImageStorage &imageStorage_;
-    QTimer *deferredUpdateTimer_;
-    mutable QSet<QPersistentModelIndex> pendingItems_;
+    ThumbnailLoader &thumbnailLoader_;
+    // Indexes shown with a placeholder, by the url of the thumbnail they wait for.
+    mutable QMultiHash<QString, QPersistentModelIndex> pendingThumbnails_;
+    // Urls whose artwork was downloaded or decoded since the last frame.
+    QSet<QString> changedThumbnails_;
+    QTimer *thumbnailTimer_;
 };
 
 #endif // LIBRARYMODEL_H
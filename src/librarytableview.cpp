@@ -1,11 +1,21 @@
 #include "librarytableview.h"
 
+#include <QHeaderView>
 #include <QKeyEvent>
 
 LibraryTableView::LibraryTableView(QWidget *parent) : QTableView(parent)
 {
 }
 
+// Gives every row the same fixed height, so the view lays rows out without asking the delegate
+// for a size hint per cell.
+void LibraryTableView::setUniformRowHeight(int height)
+{
+    verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    verticalHeader()->setMinimumSectionSize(height);
+    verticalHeader()->setDefaultSectionSize(height);
+}
+
 void LibraryTableView::keyPressEvent(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Tab &&
@@ -10,6 +10,8 @@ class LibraryTableView : public QTableView
 public:
     LibraryTableView(QWidget *parent = Q_NULLPTR);
 
+    void setUniformRowHeight(int height);
+
 protected:
     void keyPressEvent(QKeyEvent *event) override;
 };
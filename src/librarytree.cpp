@@ -0,0 +1,168 @@
+#include "librarytree.h"
+
+#include <QCollator>
+#include <QDebug>
+#include <algorithm>
+#include <numeric>
+
+// Sorts positions in items by name, then by id. keys holds the collation key of every item.
+static void sortByName(QVector<int> &positions, const QVector<LibraryItem> &items,
+                       const QVector<QCollatorSortKey> &keys)
+{
+    std::sort(positions.begin(), positions.end(), [&](int left, int right) {
+        int order = keys[left].compare(keys[right]);
+        return order != 0 ? order < 0 : items[left].id < items[right].id;
+    });
+}
+
+static QVector<QCollatorSortKey> sortKeys(const QVector<LibraryItem> &items,
+                                          const QCollator &collator)
+{
+    QVector<QCollatorSortKey> keys;
+    keys.reserve(items.size());
+    for (const auto &item : items) {
+        keys.append(collator.sortKey(item.name));
+    }
+    return keys;
+}
+
+Opt<LibraryTree> LibraryTree::load(Database &db)
+{
+    auto artists = db.artists();
+    if (!artists) {
+        qWarning() << "LibraryTree: failed to read artists from database";
+        return std::nullopt;
+    }
+    // Albums come with their artist ids, read by a second query and joined by album id.
+    auto albums = db.albums();
+    if (!albums) {
+        qWarning() << "LibraryTree: failed to read albums from database";
+        return std::nullopt;
+    }
+
+    StringPool pool;
+    QVector<LibraryItem> artistItems;
+    artistItems.reserve(artists->size());
+    for (const auto &artist : *artists) {
+        artistItems.append(
+            {artist.artistId, pool.intern(artist.name), pool.intern(artist.artistArtRef)});
+    }
+
+    QCollator collator;
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+
+    QVector<int> artistOrder(artistItems.size());
+    std::iota(artistOrder.begin(), artistOrder.end(), 0);
+    sortByName(artistOrder, artistItems, sortKeys(artistItems, collator));
+
+    LibraryTree tree;
+    QHash<QString, int> artistIndex;
+    tree.artists.reserve(artistItems.size());
+    artistIndex.reserve(artistItems.size());
+    for (int position : artistOrder) {
+        artistIndex.insert(artistItems[position].id, tree.artists.size());
+        tree.artists.append(artistItems[position]);
+    }
+
+    tree.albums.reserve(albums->size());
+    for (const auto &album : *albums) {
+        tree.albums.append(
+            {album.albumId, pool.intern(album.name), pool.intern(album.albumArtRef)});
+    }
+    tree.artistAlbums.resize(tree.artists.size());
+    for (int i = 0; i < albums->size(); ++i) {
+        for (const auto &artistId : albums->at(i).artistId) {
+            auto it = artistIndex.constFind(artistId);
+            if (it != artistIndex.constEnd()) {
+                tree.artistAlbums[it.value()].append(i);
+            }
+        }
+    }
+
+    auto albumKeys = sortKeys(tree.albums, collator);
+    for (auto &artistAlbums : tree.artistAlbums) {
+        sortByName(artistAlbums, tree.albums, albumKeys);
+    }
+
+    return std::move(tree);
+}
+
+// Diffs two sorted lists of item positions. Items with the same id and name keep their relative
+// order, so they are kept; the others are removed from from and inserted into to.
+static RowDiff diffItems(const QVector<LibraryItem> &fromItems, const QVector<int> &from,
+                         const QVector<LibraryItem> &toItems, const QVector<int> &to)
+{
+    QHash<QString, int> toRows;
+    toRows.reserve(to.size());
+    for (int j = 0; j < to.size(); ++j) {
+        toRows.insert(toItems[to[j]].id, j);
+    }
+
+    RowDiff result;
+    QVector<bool> kept(to.size(), false);
+    for (int i = 0; i < from.size(); ++i) {
+        const auto &old = fromItems[from[i]];
+        int j           = toRows.value(old.id, -1);
+        if (j < 0 || old.name != toItems[to[j]].name) {
+            RowDiff::append(result.removed, i);
+            continue;
+        }
+        kept[j] = true;
+        if (old.artUrl != toItems[to[j]].artUrl) {
+            RowDiff::append(result.changed, j);
+        }
+    }
+    std::reverse(result.removed.begin(), result.removed.end());
+
+    for (int j = 0; j < to.size(); ++j) {
+        if (!kept[j]) {
+            RowDiff::append(result.inserted, j);
+        }
+    }
+    return result;
+}
+
+// Maps every item of from to its position in to by id, -1 when to lacks it.
+static QVector<int> itemPositions(const QVector<LibraryItem> &from,
+                                  const QVector<LibraryItem> &to)
+{
+    QHash<QString, int> toPositions;
+    toPositions.reserve(to.size());
+    for (int i = 0; i < to.size(); ++i) {
+        toPositions.insert(to[i].id, i);
+    }
+
+    QVector<int> positions;
+    positions.reserve(from.size());
+    for (const auto &item : from) {
+        positions.append(toPositions.value(item.id, -1));
+    }
+    return positions;
+}
+
+LibraryTreeDiff LibraryTree::diff(const LibraryTree &from, const LibraryTree &to)
+{
+    QVector<int> fromArtists(from.artists.size());
+    std::iota(fromArtists.begin(), fromArtists.end(), 0);
+    QVector<int> toArtists(to.artists.size());
+    std::iota(toArtists.begin(), toArtists.end(), 0);
+
+    LibraryTreeDiff result;
+    result.artists         = diffItems(from.artists, fromArtists, to.artists, toArtists);
+    result.artistPositions = itemPositions(from.artists, to.artists);
+    result.albumPositions  = itemPositions(from.albums, to.albums);
+
+    for (int i = 0; i < from.artists.size(); ++i) {
+        // Albums of a moved artist are removed and inserted with it.
+        int j = result.artistPositions[i];
+        if (j < 0 || from.artists[i].name != to.artists[j].name) {
+            continue;
+        }
+        auto albums = diffItems(from.albums, from.artistAlbums[i], to.albums, to.artistAlbums[j]);
+        if (!albums.isEmpty()) {
+            result.albums.insert(i, albums);
+        }
+    }
+    return result;
+}
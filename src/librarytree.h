@@ -0,0 +1,62 @@
+#ifndef LIBRARYTREE_H
+#define LIBRARYTREE_H
+
+#include <QHash>
+#include <QVector>
+
+#include "database.h"
+#include "rowdiff.h"
+#include "trackrows.h"
+
+// What the library tree shows of an artist or album. Names and art URLs are interned.
+struct LibraryItem {
+    QString id;
+    QString name;
+    QString artUrl;
+};
+
+struct LibraryTreeDiff;
+
+// Every artist and album of the library together with the albums of each artist. Loading takes
+// three queries (artists, albums and the album artists) and joins them in memory. Artists, and
+// the albums of every artist, are sorted by name and then by id.
+struct LibraryTree {
+    QVector<LibraryItem> artists;
+    QVector<LibraryItem> albums;
+    // For the artist at the same position in artists, the positions of its albums in albums.
+    QVector<QVector<int>> artistAlbums;
+
+    static Opt<LibraryTree> load(Database &db);
+    static LibraryTreeDiff diff(const LibraryTree &from, const LibraryTree &to);
+};
+
+// Row changes turning one tree into another. An artist or album whose name changed moves, so it
+// is removed and inserted rather than changed.
+struct LibraryTreeDiff {
+    // Top-level rows, which are the positions in LibraryTree::artists.
+    RowDiff artists;
+    // Album rows of artists present in both trees, by the artist's position in the old tree.
+    QHash<int, RowDiff> albums;
+    // The position in the new tree of every artist and album of the old one, -1 when removed.
+    QVector<int> artistPositions;
+    QVector<int> albumPositions;
+};
+
+// A node of the library model. Nodes are kept by value in one vector and refer to each other by
+// their position in it, so a tree is built and freed as a single allocation.
+struct LibraryNode {
+    enum Kind : quint8 { Artist, Album };
+
+    // Position of the parent node, -1 for top-level nodes.
+    int parent;
+    int row;
+    // Position of the node's item in LibraryTree::artists or LibraryTree::albums.
+    int item;
+    Kind kind;
+    // Children are created the first time the node is expanded.
+    bool childrenLoaded;
+};
+
+using LibraryNodeList = QVector<LibraryNode>;
+
+#endif // LIBRARYTREE_H
@@ -15,6 +15,11 @@
 #include "librarymodel.h"
 #include "librarytableview.h"
 #include "tracklistmodel.h"
+#include "trackrowdelegate.h"
+#include "trackrows.h"
+
+#define TRACK_ROW_HEIGHT 30
+#define SEARCH_RESULTS_LIMIT 5000
 
 LibraryWidget::LibraryWidget(QWidget *parent) : QWidget(parent), ui(new Ui::LibraryWidget)
 {
@@ -26,25 +31,25 @@ LibraryWidget::LibraryWidget(QWidget *parent) : QWidget(parent), ui(new Ui::Libr
     auto lTreeView = new QTreeView;
     lTreeView->setModel(libraryModel_);
     connect(lTreeView, &QTreeView::activated, this, [this](const QModelIndex &index) {
-        auto node = static_cast<LibraryModelNode *>(index.internalPointer());
-        if (node->is_leaf) {
-            trackListModel_->setLoaderFunc(node->tracksLoader());
-            if (trackListTableView_->model()->rowCount() > 0) {
-                trackListTableView_->setFocusPolicy(Qt::StrongFocus);
-            } else {
-                trackListTableView_->setFocusPolicy(Qt::ClickFocus);
-            }
+        // Albums are the leaves of the tree, under their artist.
+        if (index.parent().isValid()) {
+            searchText_.clear();
+            browseLoader_ = libraryModel_->tracksLoader(index);
+            trackListModel_->setLoaderFunc(browseLoader_);
         }
     });
     lTreeView->setFocusPolicy(Qt::StrongFocus);
     lTreeView->setFocus();
 
-    trackListModel_      = new TrackListModel(this);
-    auto sortFilterModel = new TrackListSortingModel(this);
-    sortFilterModel->sort(0);
-    sortFilterModel->setSourceModel(trackListModel_);
+    trackListModel_  = new TrackListModel(this);
+    sortFilterModel_ = new TrackListSortingModel(this);
+    sortFilterModel_->setSourceModel(trackListModel_);
     trackListTableView_ = new LibraryTableView;
-    trackListTableView_->setModel(sortFilterModel);
+    trackListTableView_->setModel(sortFilterModel_);
+    trackListTableView_->setItemDelegate(new TrackRowDelegate(
+        [this](const QModelIndex &index) { return sortFilterModel_->rowAt(index); },
+        trackListTableView_));
+    trackListTableView_->setUniformRowHeight(TRACK_ROW_HEIGHT);
     trackListTableView_->setSelectionBehavior(QAbstractItemView::SelectRows);
     trackListTableView_->verticalHeader()->hide();
     trackListTableView_->horizontalHeader()->setHighlightSections(false);
@@ -57,6 +62,24 @@ LibraryWidget::LibraryWidget(QWidget *parent) : QWidget(parent), ui(new Ui::Libr
         emit play(trackId);
     });
     trackListTableView_->setFocusPolicy(Qt::ClickFocus);
+    // Tracks are loaded asynchronously, so the focus policy follows the model contents.
+    auto updateFocusPolicy = [this] {
+        if (trackListTableView_->model()->rowCount() > 0) {
+            trackListTableView_->setFocusPolicy(Qt::StrongFocus);
+        } else {
+            trackListTableView_->setFocusPolicy(Qt::ClickFocus);
+        }
+    };
+    connect(trackListModel_, &QAbstractItemModel::modelReset, this, updateFocusPolicy);
+    connect(trackListModel_, &QAbstractItemModel::rowsInserted, this, updateFocusPolicy);
+    connect(trackListModel_, &QAbstractItemModel::rowsRemoved, this, updateFocusPolicy);
+    connect(trackListModel_, &TrackListModel::loadingChanged, this, [this](bool loading) {
+        if (loading) {
+            trackListTableView_->setCursor(Qt::BusyCursor);
+        } else {
+            trackListTableView_->unsetCursor();
+        }
+    });
 
     mainSplitter_->addWidget(lTreeView);
     mainSplitter_->addWidget(trackListTableView_);
@@ -80,6 +103,9 @@ void LibraryWidget::setDatabasePath(const QString &dbPath)
 {
     libraryModel_->setDatabasePath(dbPath);
     trackListModel_->setDatabasePath(dbPath);
+    searchText_.clear();
+    browseLoader_ = nullptr;
+    trackListModel_->showAllTracks();
 }
 
 void LibraryWidget::reloadData()
@@ -114,10 +140,7 @@ void LibraryWidget::playNext()
         return;
     }
 
-    auto proxyModel = qobject_cast<TrackListSortingModel *>(trackListTableView_->model());
-    QModelIndex current =
-        proxyModel->mapFromSource(trackListModel_->getIndexForId(currentTrackId_));
-    QModelIndex next = proxyModel->index(current.row() + 1, current.column());
+    QModelIndex next = sortFilterModel_->adjacentIndex(currentTrackId_, 1);
     if (next.isValid()) {
         QString nextTrackId = next.data(TrackListModel::TrackId).toString();
         emit play(nextTrackId);
@@ -135,10 +158,7 @@ void LibraryWidget::playPrev()
         return;
     }
 
-    auto proxyModel = qobject_cast<TrackListSortingModel *>(trackListTableView_->model());
-    QModelIndex current =
-        proxyModel->mapFromSource(trackListModel_->getIndexForId(currentTrackId_));
-    QModelIndex prev = proxyModel->index(current.row() - 1, current.column());
+    QModelIndex prev = sortFilterModel_->adjacentIndex(currentTrackId_, -1);
     if (prev.isValid()) {
         QString prevTrackId = prev.data(TrackListModel::TrackId).toString();
         emit play(prevTrackId);
@@ -175,9 +195,7 @@ void LibraryWidget::handlePlayerSeekableChanged(bool seekable)
 void LibraryWidget::handlePlayerStateChanged(int state)
 {
     if (state == QMediaPlayer::PlayingState) {
-        auto proxyModel = qobject_cast<TrackListSortingModel *>(trackListTableView_->model());
-        QModelIndex index =
-            proxyModel->mapFromSource(trackListModel_->getIndexForId(currentTrackId_));
+        QModelIndex index = sortFilterModel_->indexForId(currentTrackId_);
         if (index.isValid()) {
             trackListTableView_->selectionModel()->setCurrentIndex(
                 index, QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows);
@@ -193,3 +211,48 @@ void LibraryWidget::handlePlayerStateChanged(int state)
 void LibraryWidget::setupToolbar(QToolBar *appToolbar)
 {
 }
+
+// Narrows the loaded rows down to the ones matching text on the filter's worker threads.
+void LibraryWidget::filter(const QString &text)
+{
+    sortFilterModel_->setFilterText(text);
+}
+
+// Shows the library's tracks matching text, queried with the full-text index once typing pauses;
+// an empty text shows the browsed tracks again. The rows are switched rather than reset, so rows
+// already shown stay in place and keep the filter applied to them. No query is needed while the
+// text only extends the searched one, nor for an album, whose tracks are all loaded.
+void LibraryWidget::search(const QString &text)
+{
+    if (TrackRows::searchWords(text).isEmpty()) {
+        if (!searchText_.isEmpty()) {
+            searchText_.clear();
+            showBrowsedTracks();
+        }
+        return;
+    }
+    if (browseLoader_) {
+        return;
+    }
+
+    // Matches cut off by the result limit may be the ones the longer text keeps.
+    bool refine = !searchText_.isEmpty() && text.startsWith(searchText_) &&
+                  !trackListModel_->isLoading() &&
+                  trackListModel_->rowCount() < SEARCH_RESULTS_LIMIT;
+    if (!refine) {
+        searchText_ = text;
+        trackListModel_->switchLoaderFunc(
+            [text](Database &db, const Database::TrackViewVisitor &visitor) {
+                return db.search(text, SEARCH_RESULTS_LIMIT, visitor);
+            });
+    }
+}
+
+void LibraryWidget::showBrowsedTracks()
+{
+    if (browseLoader_) {
+        trackListModel_->switchLoaderFunc(browseLoader_);
+    } else {
+        trackListModel_->switchToAllTracks();
+    }
+}
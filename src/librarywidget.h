@@ -4,9 +4,10 @@
 #include <QPersistentModelIndex>
 #include <QWidget>
 
+#include "tracklistmodel.h"
+
 class QSplitter;
 class LibraryModel;
-class TrackListModel;
 class QToolBar;
 class LibraryTableView;
 
@@ -32,6 +33,8 @@ public slots:
     void setDatabasePath(const QString &);
     void reloadData();
     void setupToolbar(QToolBar *appToolbar);
+    void filter(const QString &text);
+    void search(const QString &text);
 
     void handlePlayerStateChanged(int state);
     void handlePLayerDurationChanged(qint64 duration);
@@ -52,12 +55,20 @@ private:
     QSplitter *mainSplitter_;
     LibraryModel *libraryModel_;
     TrackListModel *trackListModel_;
+    TrackListSortingModel *sortFilterModel_;
     LibraryTableView *trackListTableView_;
 
     QString currentTrackId_;
     qint64 currentTrackPos_;
     qint64 currentTrackDuration_;
     int currentPlayerState_;
+
+    // Loads the tracks of the album selected in the tree; not set when showing all tracks.
+    TrackListModel::Loader browseLoader_;
+    // The text the shown search results were queried for, empty when not searching.
+    QString searchText_;
+
+    void showBrowsedTracks();
 };
 
 #endif // LIBRARYWIDGET_H
@@ -9,6 +9,7 @@
 #include <QTimer>
 #include <QToolBar>
 
+#include "asyncdatabase.h"
 #include "playertoolbar.h"
 #include "settingsmodel.h"
 #include "user.h"
@@ -25,6 +26,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     settingsModel_ = new SettingsModel(this);
     user_          = new User(this);
+    db_            = new AsyncDatabase(this);
 
     connect(user_, &User::emailChanged, settingsModel_, &SettingsModel::setEmail);
     connect(user_, &User::authTokenChanged, settingsModel_, &SettingsModel::setAuthToken);
@@ -187,9 +189,10 @@ void MainWindow::enterSyncState()
 void MainWindow::setupToolbar()
 {
     toolbar_ = new PlayerToolbar;
-    toolbar_->setDatabasePath(user_->databasePath());
     toolbar_->setVolume(settingsModel_->volume());
     toolbar_->setMuted(settingsModel_->muted());
+    connect(toolbar_, &PlayerToolbar::filterRequested, ui->libraryPage, &LibraryWidget::filter);
+    connect(toolbar_, &PlayerToolbar::searchRequested, ui->libraryPage, &LibraryWidget::search);
     connect(player_, &QMediaPlayer::stateChanged, toolbar_,
             &PlayerToolbar::handlePlayerStateChanged);
     connect(player_, &QMediaPlayer::durationChanged, toolbar_,
@@ -201,7 +204,6 @@ void MainWindow::setupToolbar()
     connect(player_, &QMediaPlayer::mutedChanged, toolbar_, &PlayerToolbar::setMuted);
     connect(player_, &QMediaPlayer::mutedChanged, settingsModel_, &SettingsModel::setMuted);
 
-    connect(user_, &User::databasePathChanged, toolbar_, &PlayerToolbar::setDatabasePath);
 
     connect(toolbar_, &PlayerToolbar::seek, player_, &QMediaPlayer::setPosition);
     connect(toolbar_, &PlayerToolbar::volumeChanged, this, &MainWindow::applyVolume);
@@ -224,21 +226,31 @@ void MainWindow::setCurrentTrack(const QString &trackId)
 
 void MainWindow::setDatabasePath(const QString &path)
 {
-    db_.openConnection(path);
+    db_->setDatabasePath(path);
 }
 
 void MainWindow::handlePlayerStateChanged(int state)
 {
     if (state == QMediaPlayer::PlayingState) {
-        Opt<GMTrack> track = db_.track(currentTrackId_);
-        if (!track) {
-            return;
-        }
-        Opt<GMArtist> artist = db_.artist(track->artistId.at(0));
-        if (!artist) {
-            return;
-        }
-        setWindowTitle(QString("%1 - %2").arg(artist->name).arg(track->title));
+        QString trackId = currentTrackId_;
+        db_->run(
+            [trackId](Database &db) -> Opt<QString> {
+                Opt<GMTrack> track = db.track(trackId);
+                if (!track || track->artistId.isEmpty()) {
+                    return std::nullopt;
+                }
+                Opt<GMArtist> artist = db.artist(track->artistId.at(0));
+                if (!artist) {
+                    return std::nullopt;
+                }
+                return QString("%1 - %2").arg(artist->name).arg(track->title);
+            },
+            [this, trackId](const Opt<QString> &title) {
+                if (title && trackId == currentTrackId_ &&
+                    player_->state() == QMediaPlayer::PlayingState) {
+                    setWindowTitle(*title);
+                }
+            });
     } else if (state == QMediaPlayer::StoppedState) {
         setWindowTitle(qApp->applicationName());
     }
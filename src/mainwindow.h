@@ -3,8 +3,7 @@
 
 #include <QMainWindow>
 
-#include "database.h"
-
+class AsyncDatabase;
 class User;
 class SettingsModel;
 class QTimer;
@@ -65,7 +64,7 @@ private:
     QTimer *backupTimer_;
     QString currentTrackId_;
     PlayerToolbar *toolbar_;
-    Database db_;
+    AsyncDatabase *db_;
     QStyle *appStyle_;
 
     QAction *playAction_;
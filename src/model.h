@@ -45,6 +45,17 @@ struct GMArtist {
     static std::optional<GMArtist> fromJson(const QJsonObject &json);
 };
 
+// Display-ready track row read from the denormalised TrackView table. track.artistId holds the
+// primary artist only.
+struct GMTrackView {
+    GMTrack track;
+    QString albumName;
+    int albumYear;
+    QString albumArtRef;
+    QString artistName;
+    QString artistArtRef;
+};
+
 struct GMDevice {
     QString id;
     QString friendlyName;
@@ -59,9 +70,12 @@ using GMArtistList = QList<GMArtist>;
 using GMAlbumList  = QList<GMAlbum>;
 using GMDeviceList = QList<GMDevice>;
 
+using GMTrackViewList = QList<GMTrackView>;
+
 Q_DECLARE_METATYPE(GMTrack)
 Q_DECLARE_METATYPE(GMAlbum)
 Q_DECLARE_METATYPE(GMArtist)
+Q_DECLARE_METATYPE(GMTrackView)
 Q_DECLARE_METATYPE(GMDevice)
 
 #endif // MODEL_H
@@ -8,11 +8,13 @@
 #include <QProxyStyle>
 #include <QSlider>
 #include <QSpacerItem>
+#include <QTimer>
 
-#include "database.h"
 #include "imagestorage.h"
 #include "utils.h"
 
+#define SEARCH_DELAY_MSEC 250
+
 class MyStyle : public QProxyStyle
 {
 public:
@@ -33,8 +35,6 @@ PlayerToolbar::PlayerToolbar(QWidget *parent)
 {
     ui->setupUi(this);
 
-    db_ = new Database(this);
-
     progressSlider_ = new QSlider;
     progressSlider_->setStyle(new MyStyle(progressSlider_->style()));
     progressSlider_->setOrientation(Qt::Horizontal);
@@ -90,6 +90,16 @@ PlayerToolbar::PlayerToolbar(QWidget *parent)
     searchLineEdit_->setFocusPolicy(Qt::StrongFocus);
     searchLineEdit_->setFocus();
     addWidget(searchLineEdit_);
+
+    // The loaded rows are filtered on every keystroke; the library is searched once typing pauses.
+    searchTimer_ = new QTimer(this);
+    searchTimer_->setSingleShot(true);
+    searchTimer_->setInterval(SEARCH_DELAY_MSEC);
+    connect(searchLineEdit_, &QLineEdit::textChanged, this, &PlayerToolbar::filterRequested);
+    connect(searchLineEdit_, &QLineEdit::textChanged, searchTimer_,
+            static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(searchTimer_, &QTimer::timeout, this,
+            [this] { emit searchRequested(searchLineEdit_->text()); });
 }
 
 PlayerToolbar::~PlayerToolbar()
@@ -97,11 +107,6 @@ PlayerToolbar::~PlayerToolbar()
     delete ui;
 }
 
-void PlayerToolbar::setDatabasePath(const QString &dbPath)
-{
-    db_->openConnection(dbPath);
-}
-
 void PlayerToolbar::setCurrentTrack(const QString &id)
 {
     currentTrackId_ = id;
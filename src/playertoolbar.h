@@ -5,7 +5,7 @@
 
 class QLabel;
 class QSlider;
-class Database;
+class QTimer;
 class ImageStorage;
 class SettingsModel;
 class QLineEdit;
@@ -25,7 +25,6 @@ public:
 
 public slots:
     void setCurrentTrack(const QString &id);
-    void setDatabasePath(const QString &dbPath);
     void handlePlayerStateChanged(int state);
     void handleDuratioChanged(qint64 duration);
     void handlePositionChanged(qint64 position);
@@ -42,6 +41,8 @@ signals:
     void pause();
     void next();
     void prev();
+    void filterRequested(const QString &text);
+    void searchRequested(const QString &text);
 
 private:
     Ui::PlayerToolbar *ui;
@@ -53,10 +54,10 @@ private:
     QLabel *timeLabel_;
     QSlider *volumeSlider_;
     QLineEdit *searchLineEdit_;
+    QTimer *searchTimer_;
 
     bool playerIsSeekable_;
 
-    Database *db_;
     QString currentTrackId_;
     ImageStorage &imageStorage_;
     int trackDuration_;
@@ -0,0 +1,10 @@
+#include "rowdiff.h"
+
+void RowDiff::append(QVector<Range> &ranges, int position)
+{
+    if (!ranges.isEmpty() && ranges.last().first + ranges.last().count == position) {
+        ++ranges.last().count;
+    } else {
+        ranges.append({position, 1});
+    }
+}
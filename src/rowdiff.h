@@ -0,0 +1,29 @@
+#ifndef ROWDIFF_H
+#define ROWDIFF_H
+
+#include <QVector>
+
+// Turns one sorted row list into another with model row signals. Removing the removed ranges
+// (old positions, last range first) and then inserting the inserted ranges (new positions, first
+// range first) leaves the rows of the new list in place; changed lists the new positions of kept
+// rows whose displayed data differs.
+struct RowDiff {
+    struct Range {
+        int first;
+        int count;
+    };
+
+    QVector<Range> removed;
+    QVector<Range> inserted;
+    QVector<Range> changed;
+
+    bool isEmpty() const
+    {
+        return removed.isEmpty() && inserted.isEmpty() && changed.isEmpty();
+    }
+
+    // Appends position to the last range of ranges when it directly follows it.
+    static void append(QVector<Range> &ranges, int position);
+};
+
+#endif // ROWDIFF_H
@@ -0,0 +1,104 @@
+#include "thumbnailloader.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QPixmapCache>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <optional>
+
+#include "imagestorage.h"
+
+#define THUMBNAIL_SIZE 24
+#define DECODE_THREADS 2
+
+// Reads the image at path decoded straight to thumbnail size, which for JPEG skips most of the
+// full-size decode. Returns nothing if the file cannot be read, a null image if it is not an
+// image.
+static std::optional<QImage> readThumbnail(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        return std::nullopt;
+    }
+
+    QImageReader reader(&file);
+    QSize size = reader.size();
+    if (size.isValid()) {
+        reader.setScaledSize(size.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
+        qWarning() << "could not decode" << path << reader.errorString();
+        return image;
+    }
+    if (image.width() > THUMBNAIL_SIZE || image.height() > THUMBNAIL_SIZE) {
+        image = image.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio,
+                             Qt::SmoothTransformation);
+    }
+    return image;
+}
+
+ThumbnailLoader &ThumbnailLoader::instance()
+{
+    static ThumbnailLoader loader;
+    return loader;
+}
+
+ThumbnailLoader::ThumbnailLoader(QObject *parent)
+    : QObject(parent),
+      imageStorage_(ImageStorage::instance()),
+      placeholder_(THUMBNAIL_SIZE, THUMBNAIL_SIZE)
+{
+    pool_ = new QThreadPool(this);
+    pool_->setMaxThreadCount(DECODE_THREADS);
+    placeholder_.fill(Qt::transparent);
+}
+
+QPixmap ThumbnailLoader::thumbnail(const QString &url, bool *ready)
+{
+    QPixmap *cached = QPixmapCache::find(url);
+    if (ready) {
+        *ready = cached || broken_.contains(url);
+    }
+    if (cached) {
+        return *cached;
+    }
+    if (broken_.contains(url)) {
+        return QPixmap();
+    }
+
+    if (!loading_.contains(url)) {
+        QString path = imageStorage_.cachedImagePath(url);
+        if (!path.isEmpty()) {
+            load(url, path);
+        }
+    }
+    return placeholder_;
+}
+
+// Pixmaps can only be created on the GUI thread, so the pool decodes to a QImage and the
+// conversion happens once the result is back here.
+void ThumbnailLoader::load(const QString &url, const QString &path)
+{
+    loading_.insert(url);
+    auto watcher = new QFutureWatcher<std::optional<QImage>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, url]() {
+        std::optional<QImage> image = watcher->result();
+        watcher->deleteLater();
+        loading_.remove(url);
+        if (!image) {
+            imageStorage_.discardImage(url);
+            return;
+        }
+        if (image->isNull()) {
+            broken_.insert(url);
+        } else {
+            QPixmapCache::insert(url, QPixmap::fromImage(*image));
+        }
+        emit thumbnailReady(url);
+    });
+    watcher->setFuture(QtConcurrent::run(pool_, [path]() { return readThumbnail(path); }));
+}
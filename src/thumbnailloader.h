@@ -0,0 +1,46 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+
+class ImageStorage;
+class QThreadPool;
+
+/*
+ * Decodes downloaded artwork into small thumbnails for the library views. The file is read and
+ * decoded at thumbnail size on a thread pool, so asking for a thumbnail never blocks painting.
+ * Decoded thumbnails are kept in QPixmapCache under their url.
+ */
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ThumbnailLoader &instance();
+    ThumbnailLoader(const ThumbnailLoader &) = delete;
+    ThumbnailLoader &operator=(const ThumbnailLoader &) = delete;
+
+    // Returns the thumbnail of the image at url if it is decoded, or a blank placeholder of the
+    // same size after starting to load it; thumbnailReady(url) is emitted once it is decoded.
+    // ready, if given, tells which of the two was returned.
+    QPixmap thumbnail(const QString &url, bool *ready = nullptr);
+
+signals:
+    void thumbnailReady(const QString &url);
+
+private:
+    explicit ThumbnailLoader(QObject *parent = nullptr);
+
+    void load(const QString &url, const QString &path);
+
+    ImageStorage &imageStorage_;
+    QThreadPool *pool_;
+    QPixmap placeholder_;
+    // Urls being decoded, and urls whose file could be read but not decoded.
+    QSet<QString> loading_;
+    QSet<QString> broken_;
+};
+
+#endif // THUMBNAILLOADER_H
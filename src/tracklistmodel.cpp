@@ -1,26 +1,34 @@
 #include "tracklistmodel.h"
 
 #include <QDebug>
-#include <QPixmapCache>
 #include <QStringBuilder>
 #include <QTimer>
+#include <QtConcurrent>
 
-#include "imagestorage.h"
+#include "asyncdatabase.h"
 #include "utils.h"
 
+#define LOAD_CHUNK_SIZE 500
+#define FILTER_CHUNK_SIZE 4096
+
 TrackListModel::TrackListModel(QObject *parent)
-    : QAbstractTableModel(parent), imageStorage_(ImageStorage::instance())
+    : QAbstractTableModel(parent),
+      rowsVersion_(0),
+      paged_(false),
+      hasMore_(false),
+      fetching_(false),
+      pageSize_(DefaultPageSize),
+      loadGeneration_(0),
+      chunkReplacesRows_(false),
+      loading_(false),
+      pool_(std::make_shared<StringPool>())
 {
-    deferredUpdateTimer_ = new QTimer(this);
-    deferredUpdateTimer_->setSingleShot(true);
-    deferredUpdateTimer_->setInterval(3000);
-    connect(deferredUpdateTimer_, &QTimer::timeout, this, &TrackListModel::reloadDecoationData);
-    connect(&imageStorage_, SIGNAL(imageUpdated(QString)), deferredUpdateTimer_, SLOT(start()));
+    db_ = new AsyncDatabase(this);
 }
 
 int TrackListModel::rowCount(const QModelIndex &parent) const
 {
-    return tracks_.size();
+    return rows_.size();
 }
 
 int TrackListModel::columnCount(const QModelIndex &parent) const
@@ -31,42 +39,57 @@ int TrackListModel::columnCount(const QModelIndex &parent) const
 QVariant TrackListModel::data(const QModelIndex &index, int role) const
 {
     if (index.isValid()) {
-        const auto &track = tracks_[index.row()];
+        const auto &row = rows_[index.row()];
         if (role == Qt::DisplayRole) {
             switch (index.column()) {
             case 0:
-                return track.trackNumber;
+                return row.number;
             case 1:
-                return track.title;
+                return row.title;
             case 2:
-                return albumString(track);
+                return row.album;
             case 3:
-                return artistString(track);
+                return row.artist;
             case 4:
-                return track.duration_string();
+                return row.duration;
             default:
                 return QVariant();
             }
-        } else if (role == Qt::SizeHintRole) {
-            return QSize(INT_MAX, 30);
         } else if (role == Roles::Number) {
-            return track.trackNumber;
+            return row.number;
         } else if (role == Roles::Title) {
-            return track.title;
+            return row.title;
         } else if (role == Roles::Album) {
-            return albumString(track);
+            return row.album;
         } else if (role == Roles::Artist) {
-            return artistString(track);
+            return row.artist;
         } else if (role == Roles::Duration) {
-            return track.duration_string();
+            return row.duration;
         } else if (role == Roles::TrackId) {
-            return track.id;
+            return row.id;
         }
     }
 
     return QVariant();
 }
 
+// The row behind a source row, for views that paint rows themselves.
+const TrackRow &TrackListModel::rowAt(int row) const
+{
+    return rows_[row];
+}
+
+const TrackRowList &TrackListModel::rows() const
+{
+    return rows_;
+}
+
+// Changes whenever the rows do, so results computed from rows() can be checked for staleness.
+quint64 TrackListModel::rowsVersion() const
+{
+    return rowsVersion_;
+}
+
 QVariant TrackListModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
@@ -99,125 +122,673 @@ QHash<int, QByteArray> TrackListModel::roleNames() const
     return result;
 }
 
+// Whether the rows of from that are also in to appear there in the same order.
+static bool keepsOrder(const TrackRowList &from, const QHash<QString, int> &toIndex)
+{
+    int last = -1;
+    for (const auto &row : from) {
+        int to = toIndex.value(row.id, -1);
+        if (to >= 0) {
+            if (to < last) {
+                return false;
+            }
+            last = to;
+        }
+    }
+    return true;
+}
+
+// Reloads the current tracks and updates only the rows that changed, keeping the selection and
+// scroll position of the views. In paged mode the pages fetched so far are reloaded.
 void TrackListModel::reloadTracks()
 {
-    if (loader_) {
+    loadDiff(false);
+}
+
+void TrackListModel::switchLoaderFunc(const Loader &loader)
+{
+    paged_  = false;
+    loader_ = loader;
+    loadDiff(true);
+}
+
+// As many rows as are shown are read, so the tracks they share with the library's first pages
+// stay in place.
+void TrackListModel::switchToAllTracks()
+{
+    paged_  = true;
+    loader_ = nullptr;
+    loadDiff(true);
+}
+
+// A switch supersedes the running reset or switch and shows as loading until it is applied.
+void TrackListModel::loadDiff(bool switching)
+{
+    bool paged  = paged_;
+    int limit   = qMax(rows_.size(), pageSize_);
+    auto loader = activeLoader(limit);
+    if (!loader) {
+        return;
+    }
+
+    quint64 generation = loadGeneration_;
+    if (switching) {
+        load_.cancel();
+        generation         = ++loadGeneration_;
+        chunkReplacesRows_ = false;
+        setLoading(true);
+    }
+
+    TrackRowList current = rows_;
+    quint64 version      = rowsVersion_;
+    auto pool            = pool_;
+    db_->run(
+        [loader, paged, current, pool, switching](Database &db) {
+            auto loaded = loadRows(db, loader, !paged, *pool);
+            if (loaded) {
+                // Pages keep the database order while other rows are sorted with the collator.
+                loaded->diffable = !switching || keepsOrder(current, loaded->rowIndex);
+                loaded->diff     = TrackRows::diff(current, loaded->rows, loaded->rowIndex);
+            }
+            return loaded;
+        },
+        [this, paged, limit, version, switching, generation](const Opt<LoadedRows> &loaded) {
+            if (switching) {
+                if (generation != loadGeneration_) {
+                    return;
+                }
+                setLoading(false);
+            }
+            if (!loaded) {
+                qWarning() << "could not load tracks";
+                return;
+            }
+            hasMore_ = paged && loaded->rows.size() >= limit;
+            if (version != rowsVersion_ || !loaded->diffable) {
+                // The rows changed while loading, or the diff cannot express the new order.
+                replaceRows(*loaded);
+                return;
+            }
+            applyDiff(*loaded);
+        });
+}
+
+// Replaces the rows with the tracks of a new loader, or with the first page in paged mode. Rows
+// stream in by chunks, and a load still running when the next one starts is cancelled.
+void TrackListModel::resetTracks()
+{
+    bool paged  = paged_;
+    int limit   = pageSize_;
+    auto loader = activeLoader(limit);
+    if (!loader) {
+        return;
+    }
+
+    load_.cancel();
+    quint64 generation = ++loadGeneration_;
+    chunkReplacesRows_ = true;
+    hasMore_           = false;
+    setLoading(true);
+
+    // Strings are interned per reset, so values of the previous rows are released with them.
+    auto pool = std::make_shared<StringPool>();
+    pool_     = pool;
+
+    load_ = db_->stream<RowChunk>(
+        [loader, paged, pool](Database &db, QFutureInterface<RowChunk> &promise) {
+            streamRows(db, loader, !paged, *pool, promise);
+        },
+        [this, generation](const RowChunk &chunk) {
+            if (generation == loadGeneration_) {
+                appendChunk(chunk);
+            }
+        },
+        [this, generation, paged, limit](bool canceled) {
+            if (canceled || generation != loadGeneration_) {
+                return;
+            }
+            if (chunkReplacesRows_) {
+                // Nothing was loaded.
+                replaceRows(LoadedRows());
+                chunkReplacesRows_ = false;
+            }
+            hasMore_ = paged && rows_.size() >= limit;
+            setLoading(false);
+        });
+}
+
+// The first chunk of a load replaces the previous rows, so they stay visible until then.
+void TrackListModel::appendChunk(const RowChunk &chunk)
+{
+    if (chunk.reorders) {
+        reorderRows(chunk.rows);
+        return;
+    }
+
+    if (chunkReplacesRows_) {
+        chunkReplacesRows_ = false;
         beginResetModel();
-        if (auto tracks = loader_(db_)) {
-            tracks_ = *tracks;
-        }
+        rows_ = chunk.rows;
+        rowIndex_.clear();
+        indexRows(rows_, 0, rowIndex_);
+        ++rowsVersion_;
         endResetModel();
+        return;
+    }
+
+    int first = rows_.size();
+    beginInsertRows(QModelIndex(), first, first + chunk.rows.size() - 1);
+    rows_.append(chunk.rows);
+    indexRows(rows_, first, rowIndex_);
+    ++rowsVersion_;
+    endInsertRows();
+}
+
+// Moves the rows into the order of sorted as a layout change, so selections and the current
+// index follow their tracks.
+void TrackListModel::reorderRows(const TrackRowList &sorted)
+{
+    if (sorted.size() != rows_.size()) {
+        // The rows changed since the load read them.
+        LoadedRows loaded;
+        loaded.rows = sorted;
+        indexRows(loaded.rows, 0, loaded.rowIndex);
+        replaceRows(loaded);
+        return;
+    }
+
+    QHash<QString, int> rowIndex;
+    indexRows(sorted, 0, rowIndex);
+
+    ++rowsVersion_;
+    emit layoutAboutToBeChanged();
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const auto &index : from) {
+        int row = rowIndex.value(rows_[index.row()].id, -1);
+        to.append(row < 0 ? QModelIndex() : this->index(row, index.column()));
+    }
+    changePersistentIndexList(from, to);
+    rows_     = sorted;
+    rowIndex_ = rowIndex;
+    emit layoutChanged();
+}
+
+bool TrackListModel::isLoading() const
+{
+    return loading_;
+}
+
+void TrackListModel::setLoading(bool loading)
+{
+    if (loading_ != loading) {
+        loading_ = loading;
+        emit loadingChanged(loading);
+    }
+}
+
+// The loader of the rows shown; in paged mode it reads the first limit rows of the library.
+TrackListModel::Loader TrackListModel::activeLoader(int limit) const
+{
+    if (paged_) {
+        return [limit](Database &db, const Database::TrackViewVisitor &visitor) {
+            return db.trackViewsPage(std::nullopt, limit, visitor);
+        };
+    }
+    return loader_;
+}
+
+void TrackListModel::replaceRows(const LoadedRows &loaded)
+{
+    beginResetModel();
+    rows_     = loaded.rows;
+    rowIndex_ = loaded.rowIndex;
+    ++rowsVersion_;
+    endResetModel();
+}
+
+bool TrackListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && paged_ && hasMore_ && !fetching_;
+}
+
+// Appends the page following the last row. Pages come in the database's display order, which
+// approximates the collation order with SQLite's NOCASE.
+void TrackListModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    Opt<TrackViewCursor> after;
+    if (!rows_.isEmpty()) {
+        const auto &last = rows_.last();
+        after            = TrackViewCursor{last.artist, last.album, last.number, last.id};
+    }
+    int limit       = pageSize_;
+    quint64 version = rowsVersion_;
+    auto pool       = pool_;
+    fetching_       = true;
+    db_->run(
+        [after, limit, pool](Database &db) {
+            auto loader = [after, limit](Database &db, const Database::TrackViewVisitor &visitor) {
+                return db.trackViewsPage(after, limit, visitor);
+            };
+            return loadRows(db, loader, false, *pool);
+        },
+        [this, limit, version](const Opt<LoadedRows> &page) {
+            fetching_ = false;
+            if (!page) {
+                qWarning() << "could not load tracks";
+                return;
+            }
+            if (version != rowsVersion_) {
+                // The rows were replaced while the page was loading.
+                return;
+            }
+            if (!page->rows.isEmpty()) {
+                int first = rows_.size();
+                beginInsertRows(QModelIndex(), first, first + page->rows.size() - 1);
+                rows_.append(page->rows);
+                indexRows(rows_, first, rowIndex_);
+                ++rowsVersion_;
+                endInsertRows();
+            }
+            hasMore_ = page->rows.size() >= limit;
+        });
+}
+
+// Shows the whole library, fetched page by page as the views scroll.
+void TrackListModel::showAllTracks()
+{
+    paged_  = true;
+    loader_ = nullptr;
+    resetTracks();
+}
+
+void TrackListModel::setPageSize(int pageSize)
+{
+    pageSize_ = qMax(pageSize, 1);
+}
+
+void TrackListModel::applyDiff(const LoadedRows &loaded)
+{
+    const auto &diff = loaded.diff;
+    if (diff.isEmpty()) {
+        return;
+    }
+
+    // Bumped before the first row signal: while the views handle them, results computed from the
+    // previous rows no longer line up with the row positions.
+    ++rowsVersion_;
+
+    for (const auto &range : diff.removed) {
+        beginRemoveRows(QModelIndex(), range.first, range.first + range.count - 1);
+        rows_.remove(range.first, range.count);
+        endRemoveRows();
+    }
+
+    for (const auto &range : diff.inserted) {
+        beginInsertRows(QModelIndex(), range.first, range.first + range.count - 1);
+        rows_.insert(range.first, range.count, TrackRow());
+        std::copy(loaded.rows.begin() + range.first,
+                  loaded.rows.begin() + range.first + range.count, rows_.begin() + range.first);
+        endInsertRows();
+    }
+
+    // Every row is now in place; kept rows still carry their old data and sort keys.
+    rows_     = loaded.rows;
+    rowIndex_ = loaded.rowIndex;
+
+    for (const auto &range : diff.changed) {
+        emit dataChanged(index(range.first, 0),
+                         index(range.first + range.count - 1, columnCount() - 1));
     }
 }
 
 void TrackListModel::setDatabasePath(const QString &dbPath)
 {
-    if (!db_.openConnection(dbPath, Utils::ThreadId())) {
-        qWarning() << "could not open database connection";
+    db_->setDatabasePath(dbPath);
+}
+
+// Runs on the database thread. The loaders read the denormalised TrackView table, so the display
+// strings come with the tracks and data() never has to query the database. Rows are sorted here
+// rather than in the proxy, unless they are pages that must stay in database order.
+Opt<TrackRowList> TrackListModel::readRows(Database &db, const Loader &loader, bool sort,
+                                           StringPool &pool)
+{
+    TrackRowList rows;
+    bool read = loader(db, [&rows, &pool](const GMTrackView &view) {
+        rows.append(TrackRows::fromView(view, pool));
+        return true;
+    });
+    if (!read) {
+        return std::nullopt;
+    }
+    if (sort) {
+        TrackRows::sort(rows);
     }
+    return rows;
 }
 
-inline QVariant TrackListModel::albumString(const GMTrack &track) const
+Opt<TrackListModel::LoadedRows> TrackListModel::loadRows(Database &db, const Loader &loader,
+                                                         bool sort, StringPool &pool)
 {
-    if (auto album = db_.album(track.albumId)) {
-        return album->name;
+    auto rows = readRows(db, loader, sort, pool);
+    if (!rows) {
+        return std::nullopt;
     }
-    return QVariant();
+
+    LoadedRows loaded;
+    loaded.rows = *rows;
+    indexRows(loaded.rows, 0, loaded.rowIndex);
+    return loaded;
 }
 
-inline QVariant TrackListModel::artistString(const GMTrack &track) const
+// Runs on the database thread and reports the rows in chunks of LOAD_CHUNK_SIZE while the query
+// is stepped, so the first rows show before the last are read; a cancel stops the query. The
+// rows come in SQLite's NOCASE order, and when sort is set and the collator orders them
+// differently, a reordering chunk follows once they are all read.
+void TrackListModel::streamRows(Database &db, const Loader &loader, bool sort, StringPool &pool,
+                                QFutureInterface<RowChunk> &promise)
 {
-    if (!track.artistId.isEmpty()) {
-        Opt<GMArtist> artist = db_.artist(track.artistId.at(0));
-        if (artist) {
-            return artist->name;
+    TrackRowList rows;
+    RowChunk chunk{TrackRowList(), false};
+    chunk.rows.reserve(LOAD_CHUNK_SIZE);
+    auto report = [&]() {
+        if (sort) {
+            rows.append(chunk.rows);
+        }
+        promise.reportResult(chunk);
+        chunk.rows.clear();
+    };
+
+    bool read = loader(db, [&](const GMTrackView &view) {
+        if (promise.isCanceled()) {
+            return false;
+        }
+        chunk.rows.append(TrackRows::fromView(view, pool));
+        if (chunk.rows.size() >= LOAD_CHUNK_SIZE) {
+            report();
         }
+        return true;
+    });
+    if (!read) {
+        qWarning() << "could not load tracks";
+        return;
+    }
+    if (promise.isCanceled()) {
+        return;
+    }
+    if (!chunk.rows.isEmpty()) {
+        report();
+    }
+    if (!sort) {
+        return;
+    }
+
+    TrackRowList sorted = rows;
+    TrackRows::sort(sorted);
+    bool sameOrder = std::equal(rows.begin(), rows.end(), sorted.begin(),
+                                [](const TrackRow &left, const TrackRow &right) {
+                                    return left.id == right.id;
+                                });
+    if (!sameOrder && !promise.isCanceled()) {
+        promise.reportResult(RowChunk{sorted, true});
     }
-    return QString();
 }
 
-Opt<GMTrackList> TrackListModel::loadAllTracks(Database &db)
+// Records the row of every track from first on; rows before first keep their entries.
+void TrackListModel::indexRows(const TrackRowList &rows, int first, QHash<QString, int> &rowIndex)
 {
-    return db.tracks();
+    rowIndex.reserve(rows.size());
+    for (int i = first; i < rows.size(); ++i) {
+        rowIndex.insert(rows[i].id, i);
+    }
 }
 
 void TrackListModel::setLoaderFunc(const Loader &loader)
 {
+    paged_  = false;
     loader_ = loader;
-    reloadTracks();
+    resetTracks();
 }
 
-void TrackListModel::reloadDecoationData()
+QModelIndex TrackListModel::getIndexForId(const QString &trackId) const
 {
-    emit dataChanged(index(0, 2), index(tracks_.size() - 1, 2), QVector<int>{Qt::DecorationRole});
-    emit dataChanged(index(0, 3), index(tracks_.size() - 1, 3), QVector<int>{Qt::DecorationRole});
+    auto it = rowIndex_.constFind(trackId);
+    if (it != rowIndex_.constEnd()) {
+        return index(it.value(), 0);
+    }
+    return QModelIndex();
 }
 
-QPixmap TrackListModel::getPixmap(const QString &url) const
+QModelIndex TrackListModel::getNext(const QString &trackId) const
 {
-    QPixmap *cachedImg = QPixmapCache::find(url);
-    if (cachedImg)
-        return *cachedImg;
-    QByteArray imageData = imageStorage_.tryGetImage(url);
-    if (!imageData.isEmpty()) {
-        QPixmap img;
-        if (img.loadFromData(imageData)) {
-            QPixmap scaledImg = img.scaled(24, 24, Qt::KeepAspectRatio);
-            QPixmapCache::insert(url, scaledImg);
-            return scaledImg;
-        }
+    auto it = rowIndex_.constFind(trackId);
+    if (it != rowIndex_.constEnd()) {
+        return index((it.value() + 1) % rows_.size(), 0);
     }
-    return QPixmap();
+    return QModelIndex();
 }
 
-QModelIndex TrackListModel::getIndexForId(const QString &trackId)
+QModelIndex TrackListModel::getPrev(const QString &trackId) const
 {
-    for (int i = 0; i < tracks_.size(); ++i) {
-        if (tracks_[i].id == trackId) {
-            return index(i, 0);
-        }
+    auto it = rowIndex_.constFind(trackId);
+    if (it != rowIndex_.constEnd()) {
+        int prevIndex = it.value() == 0 ? rows_.size() - 1 : it.value() - 1;
+        return index(prevIndex, 0);
     }
     return QModelIndex();
 }
 
-QModelIndex TrackListModel::getNext(const QString &trackId)
+TrackListSortingModel::TrackListSortingModel(QObject *parent)
+    : QSortFilterProxyModel(parent),
+      filterEnabled_(false),
+      filterVersion_(0),
+      filterGeneration_(0),
+      refilterPending_(false)
+{
+}
+
+void TrackListSortingModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (this->sourceModel()) {
+        disconnect(this->sourceModel(), nullptr, this, nullptr);
+    }
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+    if (sourceModel) {
+        connect(sourceModel, &QAbstractItemModel::modelReset, this,
+                &TrackListSortingModel::scheduleRefilter);
+        connect(sourceModel, &QAbstractItemModel::rowsInserted, this,
+                &TrackListSortingModel::scheduleRefilter);
+        connect(sourceModel, &QAbstractItemModel::rowsRemoved, this,
+                &TrackListSortingModel::scheduleRefilter);
+        connect(sourceModel, &QAbstractItemModel::layoutChanged, this,
+                &TrackListSortingModel::scheduleRefilter);
+        connect(sourceModel, &QAbstractItemModel::dataChanged, this,
+                &TrackListSortingModel::scheduleRefilter);
+    }
+}
+
+// Once the source is done changing, the applied filter is matched again on the worker threads and
+// its row mask replaces the one filterAcceptsRow() answers from by track id meanwhile. A running
+// match redoes itself instead.
+void TrackListSortingModel::scheduleRefilter()
 {
-    for (int i = 0; i < tracks_.size(); ++i) {
-        if (tracks_[i].id == trackId) {
-            return index((i + 1) % tracks_.size(), 0);
+    if (!filterEnabled_ || filterCanceled_ || refilterPending_) {
+        return;
+    }
+    refilterPending_ = true;
+    QTimer::singleShot(0, this, [this]() {
+        refilterPending_ = false;
+        if (filterEnabled_ && !filterCanceled_) {
+            setFilterText(filterText_);
         }
+    });
+}
+
+// Proxy index of trackId, invalid when the track is not loaded or filtered out.
+QModelIndex TrackListSortingModel::indexForId(const QString &trackId) const
+{
+    auto model = qobject_cast<TrackListModel *>(sourceModel());
+    if (!model) {
+        return QModelIndex();
     }
-    return QModelIndex();
+    return mapFromSource(model->getIndexForId(trackId));
+}
+
+// The row shown at a proxy index, nullptr when the index is invalid.
+const TrackRow *TrackListSortingModel::rowAt(const QModelIndex &proxyIndex) const
+{
+    auto model         = static_cast<const TrackListModel *>(sourceModel());
+    QModelIndex source = mapToSource(proxyIndex);
+    return source.isValid() ? &model->rowAt(source.row()) : nullptr;
+}
+
+// The visible row offset rows away from trackId; invalid past either end of the table.
+QModelIndex TrackListSortingModel::adjacentIndex(const QString &trackId, int offset) const
+{
+    QModelIndex current = indexForId(trackId);
+    if (!current.isValid()) {
+        return QModelIndex();
+    }
+    return index(current.row() + offset, 0);
 }
 
-QModelIndex TrackListModel::getPrev(const QString &trackId)
+// Shows only the rows matching every word of text; an empty text shows all rows again. Rows are
+// matched on worker threads, and a text that extends the applied one only rechecks the rows that
+// matched before. The previous filter stays applied until the new one is done.
+void TrackListSortingModel::setFilterText(const QString &text)
 {
-    for (int i = 0; i < tracks_.size(); ++i) {
-        if (tracks_[i].id == trackId) {
-            int prevIndex = i == 0 ? tracks_.size() - 1 : i - 1;
-            return index(prevIndex, 0);
+    cancelFilter();
+
+    QStringList words = TrackRows::searchWords(text);
+    if (words.isEmpty()) {
+        if (filterEnabled_) {
+            filterEnabled_ = false;
+            filterText_.clear();
+            filterWords_.clear();
+            filterRows_.clear();
+            filterMask_.clear();
+            filterIds_.clear();
+            invalidateFilter();
         }
+        return;
     }
-    return QModelIndex();
+
+    auto model = static_cast<const TrackListModel *>(sourceModel());
+    if (filterEnabled_ && words == filterWords_ && filterVersion_ == model->rowsVersion()) {
+        filterText_ = text;
+        return;
+    }
+
+    // Every row matching the longer text also matched the applied one.
+    bool refine = filterEnabled_ && filterVersion_ == model->rowsVersion() &&
+                  text.startsWith(filterText_);
+    TrackRowList rows       = model->rows();
+    QVector<int> candidates = refine ? filterRows_ : QVector<int>();
+    quint64 version         = model->rowsVersion();
+    quint64 generation      = filterGeneration_;
+    auto canceled           = std::make_shared<std::atomic_bool>(false);
+    filterCanceled_         = canceled;
+
+    auto watcher = new QFutureWatcher<FilterMatches>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this,
+            [this, watcher, generation, text, words, version, rowCount = rows.size()]() {
+                watcher->deleteLater();
+                if (generation != filterGeneration_) {
+                    return;
+                }
+                auto model = static_cast<const TrackListModel *>(sourceModel());
+                if (version != model->rowsVersion()) {
+                    // Rows changed while matching; match the current rows instead.
+                    setFilterText(text);
+                    return;
+                }
+                applyFilter(text, words, version, rowCount, watcher->result());
+            });
+    watcher->setFuture(QtConcurrent::run([rows, candidates, refine, words, canceled]() {
+        return matchRows(rows, candidates, refine, words, canceled);
+    }));
+}
+
+// Runs on a worker thread and spreads the rows, or only the candidate rows when refining, over the
+// global thread pool in chunks of FILTER_CHUNK_SIZE. Returns the matching rows in ascending order
+// and the ids of their tracks.
+TrackListSortingModel::FilterMatches
+TrackListSortingModel::matchRows(const TrackRowList &rows, const QVector<int> &candidates,
+                                 bool refine, const QStringList &words,
+                                 const std::shared_ptr<std::atomic_bool> &canceled)
+{
+    int count = refine ? candidates.size() : rows.size();
+    QList<QFuture<QVector<int>>> chunks;
+    for (int first = 0; first < count; first += FILTER_CHUNK_SIZE) {
+        int last = qMin(first + FILTER_CHUNK_SIZE, count);
+        chunks.append(QtConcurrent::run([&rows, &candidates, refine, &words, canceled, first,
+                                         last]() {
+            QVector<int> matched;
+            for (int i = first; i < last && !*canceled; ++i) {
+                int row = refine ? candidates[i] : i;
+                if (TrackRows::matches(rows[row], words)) {
+                    matched.append(row);
+                }
+            }
+            return matched;
+        }));
+    }
+
+    // Waiting runs chunks that have not started yet on this thread.
+    FilterMatches matched;
+    for (auto &chunk : chunks) {
+        matched.rows += chunk.result();
+    }
+    matched.ids.reserve(matched.rows.size());
+    for (int row : matched.rows) {
+        matched.ids.insert(rows[row].id);
+    }
+    return matched;
 }
 
-TrackListSortingModel::TrackListSortingModel(QObject *parent) : QSortFilterProxyModel(parent)
+void TrackListSortingModel::cancelFilter()
 {
+    ++filterGeneration_;
+    if (filterCanceled_) {
+        *filterCanceled_ = true;
+        filterCanceled_.reset();
+    }
+}
+
+void TrackListSortingModel::applyFilter(const QString &text, const QStringList &words,
+                                        quint64 version, int rowCount,
+                                        const FilterMatches &matched)
+{
+    filterCanceled_.reset();
+    filterEnabled_ = true;
+    filterText_    = text;
+    filterWords_   = words;
+    filterRows_    = matched.rows;
+    filterIds_     = matched.ids;
+    filterVersion_ = version;
+    filterMask_    = QBitArray(rowCount);
+    for (int row : matched.rows) {
+        filterMask_.setBit(row);
+    }
+    invalidateFilter();
 }
 
-bool TrackListSortingModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+// Answers from the row mask while the source rows are the ones the filter matched. Once they
+// change, the tracks that matched stay shown and all others, new ones included, stay hidden until
+// the refilter scheduled for the change applies its mask; no row is matched on the GUI thread.
+bool TrackListSortingModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
-    auto artistLeft  = left.data(TrackListModel::Artist).toString();
-    auto artistRight = right.data(TrackListModel::Artist).toString();
-    if (artistLeft != artistRight) {
-        return artistLeft < artistRight;
+    if (!filterEnabled_) {
+        return true;
     }
-    auto albumLeft  = left.data(TrackListModel::Album).toString();
-    auto albumRight = right.data(TrackListModel::Album).toString();
-    if (albumLeft != albumRight) {
-        return albumLeft < albumRight;
+    auto model = static_cast<const TrackListModel *>(sourceModel());
+    if (filterVersion_ == model->rowsVersion() && sourceRow < filterMask_.size()) {
+        return filterMask_.testBit(sourceRow);
     }
-    auto songNumLeft  = left.data(TrackListModel::Number).toInt();
-    auto songNumRight = right.data(TrackListModel::Number).toInt();
-    return songNumLeft < songNumRight;
+    return filterIds_.contains(model->rowAt(sourceRow).id);
 }
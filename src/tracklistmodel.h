@@ -2,21 +2,30 @@
 #define TRACKLISTMODEL_H
 
 #include <QAbstractTableModel>
+#include <QBitArray>
+#include <QFuture>
+#include <QFutureInterface>
 #include <QSet>
 #include <QSortFilterProxyModel>
+#include <atomic>
+#include <memory>
 
 #include "database.h"
 #include "model.h"
+#include "trackrows.h"
 
-class ImageStorage;
-class QTimer;
+class AsyncDatabase;
 
 class TrackListModel : public QAbstractTableModel
 {
     Q_OBJECT
 
 public:
-    using Loader = std::function<Opt<GMTrackList>(Database &)>;
+    // Hands the rows to show to the visitor, in the database's display order.
+    using Loader = std::function<bool(Database &, const Database::TrackViewVisitor &)>;
+
+    // Rows fetched at a time when showing the whole library.
+    static constexpr int DefaultPageSize = 250;
 
     TrackListModel(QObject *parent = nullptr);
 
@@ -28,35 +37,88 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation,
                         int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    const TrackRow &rowAt(int row) const;
+    const TrackRowList &rows() const;
+    quint64 rowsVersion() const;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
     Q_INVOKABLE void reloadTracks();
     void setLoaderFunc(const Loader &loader);
+    void showAllTracks();
+    // Same as setLoaderFunc() and showAllTracks(), but only the rows that differ from the shown
+    // ones are removed and inserted, as on reloadTracks().
+    void switchLoaderFunc(const Loader &loader);
+    void switchToAllTracks();
+    void setPageSize(int pageSize);
+    bool isLoading() const;
+
+    QModelIndex getIndexForId(const QString &id) const;
+    QModelIndex getNext(const QString &id) const;
+    QModelIndex getPrev(const QString &id) const;
 
-    QModelIndex getIndexForId(const QString &id);
-    QModelIndex getNext(const QString &id);
-    QModelIndex getPrev(const QString &id);
+signals:
+    void loadingChanged(bool loading);
 
 public slots:
     void setDatabasePath(const QString &dbPath);
 
-private slots:
-    void reloadDecoationData();
-
 private:
-    inline QVariant albumString(const GMTrack &track) const;
-    inline QVariant artistString(const GMTrack &track) const;
-
-    static Opt<GMTrackList> loadAllTracks(Database &);
-
-    GMTrackList tracks_;
-    mutable Database db_;
+    // Rows in display order together with the row of every track id.
+    struct LoadedRows {
+        TrackRowList rows;
+        QHash<QString, int> rowIndex;
+        // Changes from the rows the reload started from.
+        RowDiff diff;
+        // False when rows kept from those moved relative to each other, which diff cannot express.
+        bool diffable = true;
+    };
+
+    // Rows streamed by a reset. The rows of a reordering chunk are all the rows loaded so far,
+    // sorted with the collator; the other chunks follow the previous ones.
+    struct RowChunk {
+        TrackRowList rows;
+        bool reorders;
+    };
+
+    static Opt<TrackRowList> readRows(Database &db, const Loader &loader, bool sort,
+                                      StringPool &pool);
+    static Opt<LoadedRows> loadRows(Database &db, const Loader &loader, bool sort,
+                                    StringPool &pool);
+    static void streamRows(Database &db, const Loader &loader, bool sort, StringPool &pool,
+                           QFutureInterface<RowChunk> &promise);
+    static void indexRows(const TrackRowList &rows, int first, QHash<QString, int> &rowIndex);
+
+    void resetTracks();
+    void loadDiff(bool switching);
+    Loader activeLoader(int limit) const;
+    void replaceRows(const LoadedRows &loaded);
+    void appendChunk(const RowChunk &chunk);
+    void reorderRows(const TrackRowList &sorted);
+    void setLoading(bool loading);
+    void applyDiff(const LoadedRows &loaded);
+
+    TrackRowList rows_;
+    QHash<QString, int> rowIndex_;
+    // Bumped whenever rows_ changes, so a diff computed against older rows is never applied.
+    quint64 rowsVersion_;
+    AsyncDatabase *db_;
     Loader loader_;
-    QTimer *deferredUpdateTimer_;
-    ImageStorage &imageStorage_;
-
-    QPixmap getPixmap(const QString &url) const;
+    // Paged mode shows the whole library and fetches it pageSize_ rows at a time.
+    bool paged_;
+    bool hasMore_;
+    bool fetching_;
+    int pageSize_;
+    // The running reset; chunks and completions of older generations are ignored.
+    QFuture<RowChunk> load_;
+    quint64 loadGeneration_;
+    bool chunkReplacesRows_;
+    bool loading_;
+    // Interns the strings of the current rows; only used on the database thread.
+    std::shared_ptr<StringPool> pool_;
 };
 
+// Rows arrive from TrackListModel already in display order, so the proxy only filters and maps.
 class TrackListSortingModel : public QSortFilterProxyModel
 {
     Q_OBJECT
@@ -64,8 +126,47 @@ class TrackListSortingModel : public QSortFilterProxyModel
 public:
     TrackListSortingModel(QObject *parent = Q_NULLPTR);
 
+    QModelIndex indexForId(const QString &trackId) const;
+    const TrackRow *rowAt(const QModelIndex &proxyIndex) const;
+    QModelIndex adjacentIndex(const QString &trackId, int offset) const;
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    void setFilterText(const QString &text);
+
 protected:
-    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private slots:
+    void scheduleRefilter();
+
+private:
+    // Source rows matching a filter, and the ids of their tracks.
+    struct FilterMatches {
+        QVector<int> rows;
+        QSet<QString> ids;
+    };
+
+    static FilterMatches matchRows(const TrackRowList &rows, const QVector<int> &candidates,
+                                   bool refine, const QStringList &words,
+                                   const std::shared_ptr<std::atomic_bool> &canceled);
+
+    void cancelFilter();
+    void applyFilter(const QString &text, const QStringList &words, quint64 version,
+                     int rowCount, const FilterMatches &matched);
+
+    // The applied filter: its text and words, the source rows that matched them while the source
+    // rows were at version filterVersion_, and the ids of the matching tracks.
+    bool filterEnabled_;
+    QString filterText_;
+    QStringList filterWords_;
+    QVector<int> filterRows_;
+    QBitArray filterMask_;
+    QSet<QString> filterIds_;
+    quint64 filterVersion_;
+    // The running filter; results of older generations are dropped.
+    quint64 filterGeneration_;
+    std::shared_ptr<std::atomic_bool> filterCanceled_;
+    bool refilterPending_;
 };
 
 #endif // TRACKLISTMODEL_H
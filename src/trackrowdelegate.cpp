@@ -0,0 +1,85 @@
+#include "trackrowdelegate.h"
+
+#include <QApplication>
+#include <QPainter>
+
+TrackRowDelegate::TrackRowDelegate(const RowSource &rowSource, QObject *parent)
+    : QStyledItemDelegate(parent), rowSource_(rowSource)
+{
+}
+
+// Draws what QStyledItemDelegate draws for a plain text cell. The option is used as the view
+// passes it instead of going through initStyleOption(), which queries a QVariant for every role.
+void TrackRowDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                             const QModelIndex &index) const
+{
+    const TrackRow *row = rowSource_(index);
+    if (!row) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+
+    const QWidget *widget = option.widget;
+    QStyle *style         = widget ? widget->style() : QApplication::style();
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, widget);
+
+    QPalette::ColorGroup group = QPalette::Normal;
+    if (!(option.state & QStyle::State_Enabled)) {
+        group = QPalette::Disabled;
+    } else if (!(option.state & QStyle::State_Active)) {
+        group = QPalette::Inactive;
+    }
+    QPalette::ColorRole role =
+        option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text;
+
+    int margin   = style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+    QRect rect   = option.rect.adjusted(margin, 0, -margin, 0);
+    QString text = option.fontMetrics.elidedText(columnText(*row, index.column()),
+                                                 option.textElideMode, rect.width());
+    painter->save();
+    painter->setFont(option.font);
+    painter->setPen(option.palette.color(group, role));
+    painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine, text);
+    painter->restore();
+
+    if (option.state & QStyle::State_HasFocus) {
+        QStyleOptionFocusRect focus;
+        focus.QStyleOption::operator=(option);
+        focus.backgroundColor = option.palette.color(
+            group, option.state & QStyle::State_Selected ? QPalette::Highlight : QPalette::Window);
+        style->drawPrimitive(QStyle::PE_FrameFocusRect, &focus, painter, widget);
+    }
+}
+
+// Only the width is used; the table declares a uniform row height instead of asking every cell.
+QSize TrackRowDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    const TrackRow *row = rowSource_(index);
+    if (!row) {
+        return QStyledItemDelegate::sizeHint(option, index);
+    }
+
+    const QWidget *widget = option.widget;
+    QStyle *style         = widget ? widget->style() : QApplication::style();
+    int margin            = style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+    QSize text = option.fontMetrics.size(Qt::TextSingleLine, columnText(*row, index.column()));
+    return QSize(text.width() + 2 * margin, text.height());
+}
+
+QString TrackRowDelegate::columnText(const TrackRow &row, int column)
+{
+    switch (column) {
+    case 0:
+        return QString::number(row.number);
+    case 1:
+        return row.title;
+    case 2:
+        return row.album;
+    case 3:
+        return row.artist;
+    case 4:
+        return row.duration;
+    default:
+        return QString();
+    }
+}
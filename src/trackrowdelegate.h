@@ -0,0 +1,31 @@
+#ifndef TRACKROWDELEGATE_H
+#define TRACKROWDELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <functional>
+
+#include "trackrows.h"
+
+// Paints track table cells straight from the rows the model keeps, without asking the model for
+// any role. Columns are number, title, album, artist and duration, as in TrackListModel.
+class TrackRowDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    // Returns the row shown at a view index, or nullptr to fall back to the default painting.
+    using RowSource = std::function<const TrackRow *(const QModelIndex &)>;
+
+    explicit TrackRowDelegate(const RowSource &rowSource, QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    static QString columnText(const TrackRow &row, int column);
+
+private:
+    RowSource rowSource_;
+};
+
+#endif // TRACKROWDELEGATE_H
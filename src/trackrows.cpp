@@ -0,0 +1,173 @@
+#include "trackrows.h"
+
+#include <QCollator>
+#include <QHash>
+#include <QSet>
+#include <algorithm>
+#include <numeric>
+
+// Empty strings are returned as they are: a null QString binds as SQL NULL, and the page cursor
+// built from a row's album and artist must keep comparing against ''.
+QString StringPool::intern(const QString &string)
+{
+    if (string.isEmpty()) {
+        return string;
+    }
+    auto it = strings_.constFind(string);
+    if (it != strings_.constEnd()) {
+        return *it;
+    }
+    strings_.insert(string);
+    return string;
+}
+
+int StringPool::size() const
+{
+    return strings_.size();
+}
+
+// Titles are interned too: the same title often recurs across albums, and a normalized title
+// equal to the title, as a lowercase ASCII one is, shares the title's copy.
+TrackRow TrackRows::fromView(const GMTrackView &view, StringPool &pool)
+{
+    QString searchTitle = normalize(view.track.title);
+
+    TrackRow row;
+    row.id           = view.track.id;
+    row.title        = pool.intern(view.track.title);
+    row.album        = pool.intern(view.albumName);
+    row.artist       = pool.intern(view.artistName);
+    row.duration     = pool.intern(view.track.duration_string());
+    row.searchTitle  = searchTitle == row.title ? row.title : pool.intern(searchTitle);
+    row.searchAlbum  = pool.intern(normalize(view.albumName));
+    row.searchArtist = pool.intern(normalize(view.artistName));
+    row.number       = view.track.trackNumber;
+    row.artistKey    = 0;
+    row.albumKey     = 0;
+    return row;
+}
+
+QString TrackRows::normalize(const QString &text)
+{
+    QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString result;
+    result.reserve(decomposed.size());
+    for (const QChar &c : decomposed) {
+        if (c.category() != QChar::Mark_NonSpacing) {
+            result.append(c);
+        }
+    }
+    return result.toCaseFolded();
+}
+
+QStringList TrackRows::searchWords(const QString &text)
+{
+    return normalize(text).simplified().split(QLatin1Char(' '), QString::SkipEmptyParts);
+}
+
+bool TrackRows::matches(const TrackRow &row, const QStringList &words)
+{
+    for (const auto &word : words) {
+        if (!row.searchTitle.contains(word) && !row.searchAlbum.contains(word) &&
+            !row.searchArtist.contains(word)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maps every distinct string to its rank in collation order; strings the collator considers equal
+// share a rank. A library has far fewer distinct artists and albums than tracks, so each name is
+// collated once and rows are then compared as integers.
+static QHash<QString, quint32> collationRanks(const QStringList &strings,
+                                               const QCollator &collator)
+{
+    QVector<QCollatorSortKey> keys;
+    keys.reserve(strings.size());
+    for (const auto &string : strings) {
+        keys.append(collator.sortKey(string));
+    }
+
+    QVector<int> order(strings.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&keys](int left, int right) { return keys[left].compare(keys[right]) < 0; });
+
+    QHash<QString, quint32> ranks;
+    ranks.reserve(strings.size());
+    quint32 rank = 0;
+    for (int i = 0; i < order.size(); ++i) {
+        if (i > 0 && keys[order[i - 1]].compare(keys[order[i]]) != 0) {
+            ++rank;
+        }
+        ranks.insert(strings[order[i]], rank);
+    }
+    return ranks;
+}
+
+void TrackRows::sort(TrackRowList &rows, const QLocale &locale)
+{
+    QCollator collator(locale);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+
+    QSet<QString> artists;
+    QSet<QString> albums;
+    for (const auto &row : rows) {
+        artists.insert(row.artist);
+        albums.insert(row.album);
+    }
+
+    auto artistRanks = collationRanks(artists.values(), collator);
+    auto albumRanks  = collationRanks(albums.values(), collator);
+    for (auto &row : rows) {
+        row.artistKey = artistRanks.value(row.artist);
+        row.albumKey  = albumRanks.value(row.album);
+    }
+
+    std::sort(rows.begin(), rows.end(), lessThan);
+}
+
+bool TrackRows::lessThan(const TrackRow &left, const TrackRow &right)
+{
+    if (left.artistKey != right.artistKey) {
+        return left.artistKey < right.artistKey;
+    }
+    if (left.albumKey != right.albumKey) {
+        return left.albumKey < right.albumKey;
+    }
+    if (left.number != right.number) {
+        return left.number < right.number;
+    }
+    return left.id < right.id;
+}
+
+RowDiff TrackRows::diff(const TrackRowList &from, const TrackRowList &to,
+                        const QHash<QString, int> &toIndex)
+{
+    RowDiff result;
+    QVector<bool> kept(to.size(), false);
+
+    // Kept rows keep their relative order: the sort fields decide the order and they are equal.
+    for (int i = 0; i < from.size(); ++i) {
+        const auto &old = from[i];
+        int j           = toIndex.value(old.id, -1);
+        if (j < 0 || old.artist != to[j].artist || old.album != to[j].album ||
+            old.number != to[j].number) {
+            RowDiff::append(result.removed, i);
+            continue;
+        }
+        kept[j] = true;
+        if (old.title != to[j].title || old.duration != to[j].duration) {
+            RowDiff::append(result.changed, j);
+        }
+    }
+    std::reverse(result.removed.begin(), result.removed.end());
+
+    for (int j = 0; j < to.size(); ++j) {
+        if (!kept[j]) {
+            RowDiff::append(result.inserted, j);
+        }
+    }
+    return result;
+}
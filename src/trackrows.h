@@ -0,0 +1,70 @@
+#ifndef TRACKROWS_H
+#define TRACKROWS_H
+
+#include <QHash>
+#include <QLocale>
+#include <QSet>
+#include <QVector>
+
+#include "model.h"
+#include "rowdiff.h"
+
+// A track table row with its display strings resolved when the tracks are loaded. Every string but
+// the id comes from a StringPool and shares its buffer with every other row holding the same
+// value; integers are kept last so the row packs without padding.
+struct TrackRow {
+    QString id;
+    QString title;
+    QString album;
+    QString artist;
+    QString duration;
+    // Title, album and artist as TrackRows::normalize() returns them, for filtering.
+    QString searchTitle;
+    QString searchAlbum;
+    QString searchArtist;
+    int number;
+    // Collation ranks of artist and album among the rows sorted together.
+    quint32 artistKey;
+    quint32 albumKey;
+};
+
+// Hands out one shared copy of every distinct string, so values repeated across rows are stored
+// once. Not thread-safe; the strings it returns may be used from any thread.
+class StringPool
+{
+public:
+    QString intern(const QString &string);
+    int size() const;
+
+private:
+    QSet<QString> strings_;
+};
+
+using TrackRowList = QVector<TrackRow>;
+
+namespace TrackRows
+{
+TrackRow fromView(const GMTrackView &view, StringPool &pool);
+
+// Case folds text and strips its diacritics, so "Beyoncé" and "beyonce" compare equal.
+QString normalize(const QString &text);
+
+// The normalized words of a filter text.
+QStringList searchWords(const QString &text);
+
+// Whether every word occurs in the title, album or artist of row.
+bool matches(const TrackRow &row, const QStringList &words);
+
+// Computes the sort keys of rows with a collator for locale and sorts the rows by artist, album
+// and track number.
+void sort(TrackRowList &rows, const QLocale &locale = QLocale());
+
+// Display order of rows whose keys were computed by the same sort() call.
+bool lessThan(const TrackRow &left, const TrackRow &right);
+
+// Both lists must be sorted; toIndex maps the ids of to to their positions. A track whose artist,
+// album or number changed moves, so it is removed and inserted rather than changed.
+RowDiff diff(const TrackRowList &from, const TrackRowList &to, const QHash<QString, int> &toIndex);
+} // namespace TrackRows
+
+#endif // TRACKROWS_H
@@ -5,6 +5,7 @@
 #include <QStandardPaths>
 #include <QtMultimedia/QMediaPlayer>
 
+#include "asyncdatabase.h"
 #include "utils.h"
 
 SyncWorker::SyncWorker(const QString &token, QObject *parent) : QObject(parent), token_(token)
@@ -14,7 +15,7 @@ SyncWorker::SyncWorker(const QString &token, QObject *parent) : QObject(parent),
 
 void SyncWorker::run(QString dbPath)
 {
-    if (!db_.openConnection(dbPath, Utils::ThreadId())) {
+    if (!db_.openConnection(dbPath)) {
         qWarning() << "could not open database connection";
         return;
     }
@@ -28,18 +29,17 @@ void SyncWorker::run(QString dbPath)
                 return;
             }
         } while (api_->hasMoreTracks());
-        auto localtracks = db_.tracks();
-        if (!localtracks) {
+        QSet<QString> localTrackIds;
+        if (!removeDeletedTracks(allTracks, localTrackIds)) {
             qWarning() << ": could not extract tracks";
             emit errorOccured(tr("Could not load tracks from database"));
             return;
         }
-        removeDeletedTracks(allTracks, *localtracks);
         if (thread()->isInterruptionRequested()) {
             emit finished();
             return;
         }
-        mergeRemoteTracks(allTracks, *localtracks);
+        mergeRemoteTracks(allTracks, localTrackIds);
         if (thread()->isInterruptionRequested()) {
             emit finished();
             return;
@@ -52,8 +52,10 @@ void SyncWorker::run(QString dbPath)
     }
 }
 
-void SyncWorker::removeDeletedTracks(const GMTrackList &remoteTrackList,
-                                     const GMTrackList &localTracks)
+// Streams the local library page by page, removes the tracks that are gone remotely and collects
+// the ids of the ones that are kept into localTrackIds.
+bool SyncWorker::removeDeletedTracks(const GMTrackList &remoteTrackList,
+                                     QSet<QString> &localTrackIds)
 {
     QSet<QString> remoteTrackSet;
     remoteTrackSet.reserve(remoteTrackList.size());
@@ -61,53 +63,67 @@ void SyncWorker::removeDeletedTracks(const GMTrackList &remoteTrackList,
         remoteTrackSet.insert(remoteTrackList[i].id);
     }
     if (thread()->isInterruptionRequested()) {
-        return;
+        return true;
     }
 
-    for (int i = 0; i < localTracks.size(); ++i) {
-        const auto &localTrack = localTracks.at(i);
+    return db_.forEachTrack([this, &remoteTrackSet, &localTrackIds](const GMTrack &localTrack) {
         if (!remoteTrackSet.contains(localTrack.id)) {
             db_.removeTrack(localTrack.id);
+        } else {
+            localTrackIds.insert(localTrack.id);
         }
-        if (thread()->isInterruptionRequested()) {
-            return;
-        }
-    }
+        return !thread()->isInterruptionRequested();
+    });
 }
 
+// Entities fetched for the pending batch are only added to the caches once flushPending() has
+// written them, so an entity whose insert failed is fetched and written again.
 void SyncWorker::processTrack(const GMTrack &track)
 {
     if (!track.artistId.isEmpty()) {
         QString artistId = track.artistId.at(0);
-        if (!artistsCache_.contains(artistId)) {
+        if (!artistsCache_.contains(artistId) && !pendingArtistIds_.contains(artistId)) {
             GMArtist artist = wait_result<GMArtist>(api_->artist(token_, artistId));
-            bool success    = db_.insertArtist(artist);
-            if (success) {
-                artistsCache_.insert(artist.artistId);
-            }
+            pendingArtists_.append(artist);
+            pendingArtistIds_.insert(artistId);
         }
     }
-    if (!albumsCache_.contains(track.albumId)) {
+    if (!albumsCache_.contains(track.albumId) && !pendingAlbumIds_.contains(track.albumId)) {
         GMAlbum album = wait_result<GMAlbum>(api_->album(token_, track.albumId));
-        bool success  = db_.insertAlbum(album);
-        if (success) {
-            albumsCache_.insert(album.albumId);
-        }
+        pendingAlbums_.append(album);
+        pendingAlbumIds_.insert(track.albumId);
     }
-    db_.insertTrack(track);
+    pendingTracks_.append(track);
 }
 
-void SyncWorker::mergeRemoteTracks(const GMTrackList &remoteTrackList,
-                                   const GMTrackList &localtracks)
+void SyncWorker::flushPending()
 {
-    QSet<QString> localTrackSet;
-    localTrackSet.reserve(localtracks.size());
-    for (const auto &track : localtracks) {
-        localTrackSet.insert(track.id);
+    if (db_.insertArtists(pendingArtists_)) {
+        artistsCache_.unite(pendingArtistIds_);
+    } else {
+        qWarning() << "could not insert artists";
+    }
+    if (db_.insertAlbums(pendingAlbums_)) {
+        albumsCache_.unite(pendingAlbumIds_);
+    } else {
+        qWarning() << "could not insert albums";
     }
+    if (!db_.insertTracks(pendingTracks_)) {
+        qWarning() << "could not insert tracks";
+    }
+    pendingArtists_.clear();
+    pendingArtistIds_.clear();
+    pendingAlbums_.clear();
+    pendingAlbumIds_.clear();
+    pendingTracks_.clear();
+}
 
+void SyncWorker::mergeRemoteTracks(const GMTrackList &remoteTrackList,
+                                   const QSet<QString> &localTrackSet)
+{
     for (int i = 0; i < remoteTrackList.size(); ++i) {
         if (thread()->isInterruptionRequested()) {
+            flushPending();
             return;
         }
         if (localTrackSet.contains(remoteTrackList[i].id)) {
@@ -118,15 +134,20 @@ void SyncWorker::mergeRemoteTracks(const GMTrackList &remoteTrackList,
         } catch (const GMApi::Error &e) {
             qWarning() << "failed to prcoess track: " << e.what();
         }
+        if (pendingTracks_.size() >= Database::DefaultBatchSize) {
+            flushPending();
+        }
         if (i % 50 == 0) {
             emit progressChanged((double)i / remoteTrackList.size());
         }
     }
+    flushPending();
     emit progressChanged(1.0);
 }
 
 User::User(QObject *parent) : QObject(parent), syncInProgress_(false)
 {
+    db_ = new AsyncDatabase(this);
     syncThread_ = new QThread(this);
     syncThread_->start();
 }
@@ -177,11 +198,7 @@ void User::getAuthToken()
         if (status == ProxyResult::OK) {
             setAuthToken(result.toString());
             if (!deviceId_.isEmpty()) {
-                if (this->createUserData()) {
-                    this->authorizedChanged(this->authorized());
-                } else {
-                    emit this->errorOccured(tr("Could not create directory for user data"));
-                }
+                this->createUserData();
             } else {
                 this->extractDeviceId();
             }
@@ -200,11 +217,7 @@ void User::extractDeviceId()
             GMDeviceList devices = result.value<GMDeviceList>();
             QString id           = devices[0].id.replace(QRegExp("^0x"), "");
             setDeviceId(id);
-            if (this->createUserData()) {
-                this->authorizedChanged(this->authorized());
-            } else {
-                emit this->errorOccured(tr("Could not create directory for user data"));
-            }
+            this->createUserData();
         } else {
             qWarning() << "Could not extract device id: " << result.toString();
             emit this->errorOccured(tr("Could not extract registered devices"));
@@ -225,13 +238,16 @@ void User::sync()
                               Q_ARG(QString, databasePath_));
 }
 
-bool User::createUserData()
+// Creates the user's data directory and database, then reports the user as authorized. Failures
+// are reported through errorOccured().
+void User::createUserData()
 {
     QDir dataDir;
     QString appDataLocation = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     if (!dataDir.exists(appDataLocation) && !dataDir.mkpath(appDataLocation)) {
         qWarning() << "could not create app data directory";
-        return false;
+        emit errorOccured(tr("Could not create directory for user data"));
+        return;
     }
     dataDir.cd(appDataLocation);
 
@@ -243,21 +259,32 @@ bool User::createUserData()
 
     if (!dataDir.exists(userDir) && !dataDir.mkdir(userDir)) {
         qWarning() << "could not create user data directory";
-        return false;
+        emit errorOccured(tr("Could not create directory for user data"));
+        return;
     }
     dataDir.cd(userDir);
 
     QString dbPath = dataDir.filePath(QStringLiteral("storage.sqlite"));
-    if (!db_.openConnection(dbPath, Utils::ThreadId())) {
-        qWarning() << "could not open database connection";
-        return false;
-    }
-    if (!db_.createTables()) {
-        qWarning() << "could not create tables";
-        return false;
-    }
-    setDatabasePath(dbPath);
-    return true;
+    db_->run(
+        [dbPath](Database &db) {
+            if (!db.openConnection(dbPath)) {
+                qWarning() << "could not open database connection";
+                return false;
+            }
+            if (!db.createTables()) {
+                qWarning() << "could not create tables";
+                return false;
+            }
+            return true;
+        },
+        [this, dbPath](bool success) {
+            if (!success) {
+                emit errorOccured(tr("Could not create user database"));
+                return;
+            }
+            setDatabasePath(dbPath);
+            emit authorizedChanged(authorized());
+        });
 }
 
 void User::requestSyncInterruption()
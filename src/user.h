@@ -24,9 +24,10 @@ public slots:
     void run(QString dbPath);
 
 private:
-    void removeDeletedTracks(const GMTrackList &remoteTrackList, const GMTrackList &localtracks);
-    void mergeRemoteTracks(const GMTrackList &remoteTrackList, const GMTrackList &localtracks);
+    bool removeDeletedTracks(const GMTrackList &remoteTrackList, QSet<QString> &localTrackIds);
+    void mergeRemoteTracks(const GMTrackList &remoteTrackList, const QSet<QString> &localTrackSet);
     void processTrack(const GMTrack &track);
+    void flushPending();
 
     template <class T> T wait_result(ProxyResult *proxy)
     {
@@ -50,10 +51,19 @@ private:
     Database db_;
     GMApi *api_;
 
+    // Ids of the albums and artists already written to the database.
     QSet<QString> albumsCache_;
     QSet<QString> artistsCache_;
+
+    // The next batch to write, with the ids its albums and artists were fetched for.
+    GMArtistList pendingArtists_;
+    QSet<QString> pendingArtistIds_;
+    GMAlbumList pendingAlbums_;
+    QSet<QString> pendingAlbumIds_;
+    GMTrackList pendingTracks_;
 };
 
+class AsyncDatabase;
 class QThreadPool;
 
 class User : public QObject
@@ -166,11 +176,11 @@ private:
     void getAuthToken();
 
     GMApi api_;
-    Database db_;
+    AsyncDatabase *db_;
     bool syncInProgress_;
     QThread *syncThread_;
 
-    bool createUserData();
+    void createUserData();
 };
 
 #endif // USER_H